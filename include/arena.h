@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+#define ARENA_ALIGN             16
+
+
+typedef struct
+{
+    unsigned char* base;
+    size_t size;
+    size_t used;
+} arena_t;
+
+
+bool arena_reserve(arena_t* arena, size_t size);
+void arena_destroy(arena_t* arena);
+void* arena_alloc(arena_t* arena, size_t size);
+
+
+static inline size_t arena_mark(const arena_t* arena)
+{
+    return arena->used;
+}
+
+
+static inline void arena_release(arena_t* arena, size_t mark)
+{
+    /* frees everything allocated since the mark was taken */
+    arena->used = mark;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "bitboard.h"
+#include "board.h"
+
+
+#define ATTACK_DIRECTIONS       8
+#define ATTACK_LIST_END         -1
+
+
+typedef enum
+{
+    DIRECTION_EAST = 0,
+    DIRECTION_NORTH,
+    DIRECTION_WEST,
+    DIRECTION_SOUTH,
+    DIRECTION_NORTH_EAST,
+    DIRECTION_NORTH_WEST,
+    DIRECTION_SOUTH_WEST,
+    DIRECTION_SOUTH_EAST,
+} direction_t;
+
+#define DIRECTION_IS_DIAGONAL(_dir)     ((_dir) >= DIRECTION_NORTH_EAST)
+
+
+typedef struct attack_tables
+{
+    int width;
+    int height;
+    int ray_len;
+    /* square lists terminated by ATTACK_LIST_END, indexed by square */
+    int* knight;
+    int* king;
+    int* pawn[COLOUR_COUNT];
+    /* rays hold the squares along a direction in order of distance */
+    int* rays[ATTACK_DIRECTIONS];
+    /* masks of the lists above, only built for boards with bitboards */
+    bitboard_t* knight_mask;
+    bitboard_t* king_mask;
+    bitboard_t* pawn_mask[COLOUR_COUNT];
+    bitboard_t* ray_mask[ATTACK_DIRECTIONS];
+    /* whether square indices grow walking along the direction */
+    bool ray_ascending[ATTACK_DIRECTIONS];
+    struct attack_tables* next;
+} attack_tables_t;
+
+
+const attack_tables_t* attack_tables_get(int width, int height);
+
+
+static inline const int* attacks_knight(const attack_tables_t* t, int sq)
+{
+    return &t->knight[sq * 9];
+}
+
+
+static inline const int* attacks_king(const attack_tables_t* t, int sq)
+{
+    return &t->king[sq * 9];
+}
+
+
+static inline const int* attacks_pawn(const attack_tables_t* t, colour_t colour, int sq)
+{
+    return &t->pawn[colour][sq * 3];
+}
+
+
+static inline const int* attacks_ray(const attack_tables_t* t, direction_t dir, int sq)
+{
+    return &t->rays[dir][sq * t->ray_len];
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+
+/* Batch analysis of FEN/EPD lines. Each input line gives one output line,
+ * in the same order:
+ *   <position fields> bm <uci>; ce <centipawns>; status <status>; <ops>
+ * ce is the static evaluation for the side to move; finished games have no
+ * bm or ce. Operations from the input other than bm, ce and status are kept,
+ * blank lines and '#' comments are copied as they are, and positions that
+ * can't be read get "status invalid;". Lines are read as a stream through a
+ * fixed window, so memory doesn't grow with the size of the input. */
+#define BATCH_LINE_LEN          1024
+#define BATCH_RESULT_LEN        (BATCH_LINE_LEN + 128)
+#define BATCH_WINDOW            256
+#define BATCH_MAX_THREADS       256
+
+
+typedef struct
+{
+    long positions;     /* analysed, invalid ones not included */
+    long invalid;
+    uint64_t elapsed_us;
+} batch_stats_t;
+
+
+bool batch_analyse(FILE* in, FILE* out, int threads, const search_limits_t* limits, batch_stats_t* stats);
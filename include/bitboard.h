@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define BITBOARD_MAX_SQUARES    64
+
+
+typedef uint64_t bitboard_t;
+
+
+static inline bitboard_t bitboard_square(int idx)
+{
+    return (bitboard_t)1 << idx;
+}
+
+
+static inline bool bitboard_test(bitboard_t bb, int idx)
+{
+    return !!(bb & bitboard_square(idx));
+}
+
+
+static inline int bitboard_count(bitboard_t bb)
+{
+    return __builtin_popcountll(bb);
+}
+
+
+static inline int bitboard_lsb(bitboard_t bb)
+{
+    return __builtin_ctzll(bb);
+}
+
+
+static inline int bitboard_msb(bitboard_t bb)
+{
+    return 63 - __builtin_clzll(bb);
+}
+
+
+static inline int bitboard_pop_lsb(bitboard_t* bb)
+{
+    int idx = __builtin_ctzll(*bb);
+    *bb &= *bb - 1;
+    return idx;
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "bitboard.h"
 
 
 typedef enum
@@ -14,6 +17,8 @@ typedef enum
     PIECE_TYPE_KING
 } piece_type_t;
 
+#define PIECE_TYPE_COUNT        (PIECE_TYPE_KING + 1)
+
 typedef enum
 {
     COLOUR_NONE = 0,
@@ -21,24 +26,55 @@ typedef enum
     COLOUR_BLACK
 } colour_t;
 
+#define COLOUR_COUNT            (COLOUR_BLACK + 1)
+
+/* castling rights, king side with the rook on the last file */
+#define CASTLE_WHITE_KING       0x1
+#define CASTLE_WHITE_QUEEN      0x2
+#define CASTLE_BLACK_KING       0x4
+#define CASTLE_BLACK_QUEEN      0x8
+#define CASTLE_WHITE            (CASTLE_WHITE_KING | CASTLE_WHITE_QUEEN)
+#define CASTLE_BLACK            (CASTLE_BLACK_KING | CASTLE_BLACK_QUEEN)
+#define CASTLE_ALL              (CASTLE_WHITE | CASTLE_BLACK)
+
 typedef struct
 {
     piece_type_t type;
     colour_t colour;
 } piece_t;
 
+struct attack_tables;
+
 typedef struct
 {
     int width;
     int height;
     piece_t* squares;
+    const struct attack_tables* attacks;
+    /* Boards with at most BITBOARD_MAX_SQUARES squares also keep one
+     * occupancy mask per colour and piece type, bit n being square index n.
+     * Larger boards only use the square array. */
+    bool has_bitboards;
+    bitboard_t pieces[COLOUR_COUNT][PIECE_TYPE_COUNT];
+    bitboard_t occupied[COLOUR_COUNT];
+    /* CASTLE_* rights still held, and the square a pawn just skipped when
+     * it can be taken en passant (-1 otherwise); make_move keeps both */
+    unsigned castling;
+    int en_passant;
+    /* Zobrist key of the pieces, kept up to date by set_piece, with the
+     * castling and en passant keys and the side key mixed in while black
+     * is to move */
+    uint64_t hash;
 } board_t;
 
 
 board_t* create_board(int width, int height);
 void destroy_board(board_t* b);
-bool copy_board(board_t* new_b, board_t* b);
-board_t* duplicate_board(board_t* b);
+bool copy_board(board_t* new_b, const board_t* b);
+board_t* duplicate_board(const board_t* b);
+bool boards_equal(const board_t* a, const board_t* b);
 piece_t* get_piece(const board_t* b, int index);
 void set_piece(board_t* b, int index, piece_t* p);
 void clear_board(board_t* b);
+void sync_bitboards(board_t* b);
+int find_next_piece(const board_t* b, colour_t colour, int from);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "move.h"
+
+
+/* Book file layout, all little endian:
+ *   header:  8 byte magic, u32 entry count, u32 reserved
+ *   entries: u64 position hash, u16 from, u16 to, u8 promotion, u8 reserved,
+ *            u16 weight
+ * Entries are sorted by hash, a position's moves being adjacent. */
+#define BOOK_MAGIC              "WCBOOK02"      /* 02: keys cover castling and en passant */
+#define BOOK_MAGIC_NAME_LEN     6               /* "WCBOOK", the rest is the version */
+#define BOOK_HEADER_SIZE        16
+#define BOOK_ENTRY_SIZE         16
+
+
+bool book_open(const char* path);
+bool book_adopt(void* data, size_t size);
+void book_close(void);
+bool book_loaded(void);
+size_t book_entry_count(void);
+bool book_probe(uint64_t key, const move_list_t* legal_moves, uint64_t* random_state, move_t* move);
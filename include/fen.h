@@ -1,9 +1,31 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "board.h"
 #include "move.h"
 
 
+#define FEN_FIELD_COUNT         6
+
+/* The fields kept outside the board; castling rights and the en passant
+ * square are read into the board itself. Those a FEN leaves out take the
+ * values of a new game: white to move and clocks at 0 and 1. Without a
+ * castling field, rights are given for every rook still in its corner with
+ * its king on the same rank. */
+typedef struct
+{
+    colour_t turn;
+    int halfmove_clock;
+    int fullmove_number;
+    int fields;                 /* how many fields were read, placement included */
+} fen_state_t;
+
+
+void fen_state_init(fen_state_t* state, colour_t turn);
+int fen_parse(board_t* b, const char* fen, fen_state_t* state);
+int fen_write(const board_t* b, const fen_state_t* state, char* out_fen, int max_len);
+bool fen_dimensions(const char* fen, int* width, int* height);
 board_t* parse_fen(const char* fen, colour_t* out_turn);
 int generate_fen(const board_t* b, colour_t turn, char* out_fen, int max_len);
 int pos_to_index(const board_t* b, const char* pos);
@@ -1,11 +1,30 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
+#include "arena.h"
 #include "board.h"
+#include "fen.h"
 #include "move.h"
+#include "poscache.h"
 
 
+#define GAME_SCRATCH_MOVE_LISTS 4
+#define GAME_HISTORY_SIZE       128     /* more than the fifty move rule's 100 plies */
+#define GAME_REPETITION_SLOTS   256
+#define GAME_FIFTY_MOVE_PLIES   100
+
+
+/* how long the search may think about a move, each game has its own */
+typedef struct
+{
+    int max_depth;
+    int max_time_ms;            /* 0 for no time budget */
+    long max_nodes;             /* 0 for no node budget */
+    int threads;
+} search_limits_t;
+
 typedef struct
 {
     int width;
@@ -13,6 +32,9 @@ typedef struct
     bool allow_custom_rules;
     bool enable_castling;
     bool enable_en_passant;
+    unsigned position_cache_entries;    /* 0 leaves the position cache off */
+    uint64_t random_state;      /* for generators that pick at random, 0 seeds it from the clock */
+    search_limits_t search;     /* 0 threads takes the search's defaults */
 } game_config_t;
 
 typedef enum
@@ -20,15 +42,61 @@ typedef enum
     STATUS_ONGOING,
     STATUS_CHECK,
     STATUS_CHECKMATE,
-    STATUS_STALEMATE
+    STATUS_STALEMATE,
+    STATUS_REPETITION,          /* threefold */
+    STATUS_FIFTY_MOVES
 } game_status_t;
 
+/* how the position was reached, for engines that must not walk into a
+ * repetition: the hashes since the last capture or pawn move, oldest
+ * first and ending with the current position */
+typedef struct
+{
+    uint64_t hashes[GAME_HISTORY_SIZE];
+    unsigned count;
+    int halfmove_clock;
+} game_history_t;
+
+
+/* one game in progress, any number can be live at once */
+typedef struct
+{
+    game_config_t config;
+    board_t* board;
+    colour_t turn;
+    game_status_t status;
+    arena_t scratch;
+    move_list_t legal_moves;    /* side to move's, rebuilt with the status */
+    poscache_t positions;       /* positions already visited */
+    int halfmove_clock;         /* plies since the last capture or pawn move */
+    int fullmove_number;
+    /* Hashes of the positions since the last capture or pawn move, none of
+     * which can come back after one, as a ring from history_first. Each
+     * also counts towards a slot by its low bits, so a position can only
+     * have been seen three times when its slot has reached three. */
+    uint64_t history[GAME_HISTORY_SIZE];
+    unsigned history_first;
+    unsigned history_count;
+    uint8_t repetitions[GAME_REPETITION_SLOTS];
+} game_t;
+
 
-void game_init(const game_config_t* cfg);
-void game_set_board(const board_t* b, colour_t turn);
-board_t* game_get_board(void);
-bool game_get_best_move(move_t* m);
-bool game_apply_move(move_t* m);
-game_status_t game_get_status(void);
-colour_t game_current_turn(void);
-int game_get_available_moves(unsigned index, move_t* moves, unsigned max_moves);
+game_t* game_create(const game_config_t* cfg);
+void game_destroy(game_t* game);
+void game_init(game_t* game, const game_config_t* cfg);
+void game_set_seed(game_t* game, uint64_t seed);
+void game_set_board(game_t* game, const board_t* b, colour_t turn);
+int game_set_fen(game_t* game, const char* fen, fen_state_t* out_state);
+int game_get_fen(const game_t* game, char* out_fen, int max_len);
+board_t* game_get_board(game_t* game);
+arena_t* game_get_scratch(game_t* game);
+uint64_t game_get_hash(const game_t* game);
+void game_get_history(const game_t* game, game_history_t* history);
+bool game_get_best_move(game_t* game, move_t* m);
+bool game_apply_move(game_t* game, move_t* m);
+game_status_t game_get_status(const game_t* game);
+colour_t game_current_turn(const game_t* game);
+int game_get_available_moves(game_t* game, unsigned index, move_t* moves, unsigned max_moves);
+const move_list_t* game_get_legal_moves(const game_t* game);
+bool game_set_position_cache_size(game_t* game, unsigned entries);
+void game_get_position_cache_stats(const game_t* game, poscache_stats_t* stats);
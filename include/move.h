@@ -1,15 +1,88 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
 #include "board.h"
 
 
+#define MOVE_SQUARE_BITS        13
+#define MOVE_MAX_SQUARES        (1 << (MOVE_SQUARE_BITS - 1))   /* signed, -1 is no square */
+#define MOVE_LIST_CAPACITY      256     /* the most legal moves known in 8x8 chess is 218 */
+
+
+typedef enum
+{
+    MOVE_FLAG_NONE = 0,
+    MOVE_FLAG_DOUBLE_PUSH,
+    MOVE_FLAG_EN_PASSANT,
+    MOVE_FLAG_CASTLING
+} move_flag_t;
+
 typedef struct
 {
-    int from;
-    int to;
-    piece_type_t promotion;
+    signed int from : MOVE_SQUARE_BITS;
+    signed int to : MOVE_SQUARE_BITS;
+    unsigned int promotion : 3;     /* piece_type_t */
+    unsigned int flags : 3;         /* move_flag_t, set by the generator */
 } move_t;
 
+_Static_assert(sizeof(move_t) == sizeof(uint32_t), "move_t should pack into 32 bits");
+
+/* Big enough for any 8x8 position. A custom board can have more legal
+ * moves than fit, and then the list says so: the rules fall back to
+ * generating square by square, while engines choose among the moves that
+ * fit. */
+typedef struct
+{
+    int count;
+    bool truncated;
+    move_t moves[MOVE_LIST_CAPACITY];
+} move_list_t;
+
+
+static inline move_t move_encode(int from, int to, piece_type_t promotion, move_flag_t flags)
+{
+    move_t m = { from, to, promotion, flags };
+    return m;
+}
+
+
+static inline uint32_t move_pack(const move_t* m)
+{
+    uint32_t packed;
+    memcpy(&packed, m, sizeof(packed));
+    return packed;
+}
+
+
+static inline move_t move_unpack(uint32_t packed)
+{
+    move_t m;
+    memcpy(&m, &packed, sizeof(m));
+    return m;
+}
+
+
+static inline bool move_equal(const move_t* a, const move_t* b)
+{
+    /* flags follow from the position, so they are not compared */
+    return a->from == b->from && a->to == b->to && a->promotion == b->promotion;
+}
+
+
+static inline bool move_list_push(move_list_t* list, move_t m)
+{
+    if (list->count >= MOVE_LIST_CAPACITY)
+    {
+        list->truncated = true;
+        return false;
+    }
+    list->moves[list->count++] = m;
+    return true;
+}
+
 
 static inline int index_to_x(board_t* board, int idx)
 {
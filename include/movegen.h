@@ -10,11 +10,13 @@
 typedef struct
 {
     const char name[128];
-    bool (*generator)(game_config_t* config, board_t* board, colour_t turn, move_t* move, game_status_t status);
+    bool deterministic;     /* the same position always gets the same move */
+    bool (*generator)(game_config_t* config, board_t* board, colour_t turn, const move_list_t* legal_moves, arena_t* scratch, move_t* move, game_status_t status, const game_history_t* history);
 } movegen_t;
 
 
-bool movegen_get_move(game_config_t* config, board_t* board, colour_t turn, move_t* move, game_status_t status);
+bool movegen_get_move(game_config_t* config, board_t* board, colour_t turn, const move_list_t* legal_moves, arena_t* scratch, move_t* move, game_status_t status, const game_history_t* history, bool* repeatable);
 int movegen_list(char** list, unsigned list_len, unsigned row_len);
+const movegen_t* movegen_find(const char* name);
 bool movegen_set(const char* name);
 const char* movegen_get(void);
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "board.h"
+
+
+uint64_t perft(board_t* board, colour_t turn, int depth);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "move.h"
+
+
+/* A per game LRU cache of what the rules worked out for a position, keyed by
+ * its hash: the status, the legal moves and the last best move given for
+ * it. Going back over a game, by undo or replay, finds the positions here
+ * instead of generating them again. */
+#define POSCACHE_DEFAULT_ENTRIES        64
+#define POSCACHE_MAX_ENTRIES            65536
+
+
+typedef struct
+{
+    uint64_t key;
+    int status;                 /* a game_status_t */
+    move_list_t legal_moves;
+    move_t best_move;
+    unsigned best_epoch;        /* 0 when there's no best move */
+    int prev;                   /* recency list, most recent first */
+    int next;
+    int chain;                  /* next entry in the same bucket */
+} poscache_entry_t;
+
+typedef struct
+{
+    poscache_entry_t* entries;
+    int* buckets;
+    unsigned capacity;
+    unsigned used;
+    unsigned bucket_mask;
+    int head;
+    int tail;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t best_move_hits;
+    uint64_t evictions;
+} poscache_t;
+
+typedef struct
+{
+    unsigned capacity;
+    unsigned used;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t best_move_hits;
+    uint64_t evictions;
+} poscache_stats_t;
+
+
+bool poscache_init(poscache_t* cache, unsigned capacity);
+void poscache_destroy(poscache_t* cache);
+void poscache_clear(poscache_t* cache);
+bool poscache_lookup(poscache_t* cache, uint64_t key, int* status, move_list_t* legal_moves);
+void poscache_store(poscache_t* cache, uint64_t key, int status, const move_list_t* legal_moves);
+bool poscache_best_move(poscache_t* cache, uint64_t key, move_t* move);
+void poscache_store_best_move(poscache_t* cache, uint64_t key, const move_t* move, unsigned epoch);
+unsigned poscache_epoch(void);
+void poscache_forget_best_moves(void);
+void poscache_get_stats(const poscache_t* cache, poscache_stats_t* stats);
@@ -6,11 +6,64 @@
 #include "move.h"
 
 
-bool is_pawn_last_rank(board_t* board, move_t* m, colour_t colour);
+#define UNDO_STACK_SIZE         128
+
+
+typedef struct
+{
+    move_t move;
+    piece_t moved;
+    piece_t captured;
+    int captured_index;
+    int rook_from;
+    int rook_to;
+    unsigned castling;
+    int en_passant;
+    uint64_t hash;
+} undo_t;
+
+typedef struct
+{
+    undo_t entries[UNDO_STACK_SIZE];
+    unsigned count;
+} undo_stack_t;
+
+
+static inline int max_piece_moves(const board_t* board)
+{
+    /* bound on one piece's pseudo-legal moves: a queen's reach, with slack
+     * for castling and promotions */
+    return 2 * (board->width + board->height) + 12;
+}
+
+
+bool is_pawn_last_rank(board_t* board, move_t* m);
 bool is_move_legal(board_t* board, move_t* m);
 int find_king(board_t* board, colour_t colour);
+bool is_square_attacked(board_t* board, int sq_index, colour_t by_colour);
+int count_attackers(board_t* board, int sq_index, colour_t by_colour);
 bool is_in_check(board_t* board, colour_t colour);
-int generate_moves(board_t* board, unsigned index, bool in_check, move_t* moves, int max_moves);
-bool generate_all_moves(board_t* board, colour_t colour, bool in_check, move_t* moves, int max_moves, int* move_count);
+bool can_take_en_passant(const board_t* board, int sq, colour_t colour);
+int generate_pseudo_moves(board_t* board, unsigned index, move_t* moves, int max_moves);
+int generate_moves(board_t* board, unsigned index, move_t* moves, int max_moves);
+bool generate_all_moves(board_t* board, colour_t colour, move_list_t* list);
+bool resolve_move(board_t* board, move_t* m);
 bool would_move_release_check(board_t* board, move_t* m);
 bool has_legal_moves(board_t* board, colour_t colour);
+void make_move(board_t* board, const move_t* m, undo_t* undo);
+void unmake_move(board_t* board, const undo_t* undo);
+
+
+static inline bool push_move(board_t* board, undo_stack_t* stack, const move_t* m)
+{
+    if (stack->count >= UNDO_STACK_SIZE)
+        return false;
+    make_move(board, m, &stack->entries[stack->count++]);
+    return true;
+}
+
+
+static inline void pop_move(board_t* board, undo_stack_t* stack)
+{
+    unmake_move(board, &stack->entries[--stack->count]);
+}
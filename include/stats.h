@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util.h"
+
+
+/* Profiling counters, compiled in with -DENGINE_STATS (make ENGINE_STATS=1)
+ * and to nothing otherwise. They are shared by every game and thread. Phase
+ * times are wall clock and inclusive, a best move's time takes in the book
+ * and generator phases under it. */
+typedef enum
+{
+    STAT_IS_MOVE_LEGAL,
+    STAT_IS_SQUARE_ATTACKED,
+    STAT_BOARD_COPIES,
+    STAT_MOVES_GENERATED,
+    STAT_MOVES_MADE,
+    STAT_NODES,
+    STAT_EVALUATIONS,
+    STAT_MOVES_SCORED,
+    STAT_COUNT
+} stat_counter_t;
+
+typedef enum
+{
+    PHASE_STATUS,
+    PHASE_APPLY_MOVE,
+    PHASE_BEST_MOVE,
+    PHASE_BOOK,
+    PHASE_TABLEBASE,
+    PHASE_GENERATOR,
+    PHASE_PERFT,
+    PHASE_COUNT
+} stat_phase_t;
+
+
+#ifdef ENGINE_STATS
+#define STATS_ENABLED                   true
+#define STATS_ADD(counter, n)           stats_add((counter), (uint64_t)(n))
+#define STATS_TIMER_START()             monotonic_us()
+#define STATS_TIMER_STOP(phase, start)  stats_add_time((phase), (start))
+#else
+#define STATS_ENABLED                   false
+#define STATS_ADD(counter, n)           ((void)0)
+#define STATS_TIMER_START()             ((uint64_t)0)
+#define STATS_TIMER_STOP(phase, start)  ((void)(start))
+#endif
+#define STATS_COUNT(counter)            STATS_ADD(counter, 1)
+
+
+void stats_add(stat_counter_t counter, uint64_t n);
+void stats_add_time(stat_phase_t phase, uint64_t start_us);
+void stats_reset(void);
+uint64_t stats_counter(stat_counter_t counter);
+uint64_t stats_phase_calls(stat_phase_t phase);
+uint64_t stats_phase_us(stat_phase_t phase);
+int stats_to_json(char* out, int max_len);
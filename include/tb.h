@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "move.h"
+
+
+/* Endgame tables for 8x8 boards, one file per material signature such as
+ * "KQK" or "KRKP", white's pieces first. A file is a header of magic and
+ * signature followed by one cell per position index:
+ *   bits 0-1: tb_wdl_t for the side to move
+ *   bits 2-7: moves to mate, for wins and losses
+ * Positions are indexed by side to move, the white king's square folded by
+ * symmetry (10 squares without pawns, 32 with), then 64 squares for each
+ * other piece; the table for the stronger side as white serves both. */
+#define TB_MAX_PIECES           4
+#define TB_MAGIC                "WCTB0001"
+#define TB_SIGNATURE_LEN        8
+#define TB_HEADER_SIZE          16
+#define TB_BOARD_SIZE           8
+#define TB_MAX_TABLES           64
+#define TB_MAX_DTM              63
+
+#define TB_CELL_WDL_MASK        0x3u
+#define TB_CELL_DTM_SHIFT       2
+
+
+typedef enum
+{
+    TB_DRAW = 0,
+    TB_WIN,
+    TB_LOSS,
+    TB_ILLEGAL
+} tb_wdl_t;
+
+typedef struct
+{
+    tb_wdl_t wdl;
+    int dtm;        /* moves until mate, 0 when mated */
+} tb_result_t;
+
+typedef struct
+{
+    int count;
+    colour_t turn;
+    piece_t pieces[TB_MAX_PIECES];
+    int squares[TB_MAX_PIECES];     /* 0 is a8 */
+} tb_position_t;
+
+
+bool tb_load(const char* path);
+bool tb_adopt(void* data, size_t size);
+int tb_open(const char* dir);
+void tb_close(void);
+int tb_max_pieces(void);
+
+bool tb_normalise(const tb_position_t* pos, tb_position_t* out);
+bool tb_normalise_signature(const char* signature, char* out);
+void tb_signature(const tb_position_t* normalised, char* out);
+bool tb_has_pawns(const char* signature);
+uint64_t tb_table_positions(const char* signature);
+uint64_t tb_index(const tb_position_t* normalised);
+bool tb_decode(const char* signature, uint64_t index, tb_position_t* out);
+
+bool tb_probe_position(const tb_position_t* pos, tb_result_t* result);
+bool tb_probe(const board_t* board, colour_t turn, tb_result_t* result);
+bool tb_best_move(board_t* board, colour_t turn, const move_list_t* legal_moves, move_t* move);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "move.h"
+
+
+#define TT_DEFAULT_SIZE_MB      4
+#define TT_BUCKET_ENTRIES       4
+
+
+typedef enum
+{
+    TT_BOUND_NONE = 0,
+    TT_BOUND_EXACT,
+    TT_BOUND_LOWER,
+    TT_BOUND_UPPER
+} tt_bound_t;
+
+typedef struct
+{
+    move_t move;
+    int score;
+    int depth;
+    tt_bound_t bound;
+} tt_result_t;
+
+typedef struct
+{
+    unsigned size_mb;
+    uint64_t entries;
+    uint64_t used;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+} tt_stats_t;
+
+
+void tt_init(void);
+bool tt_resize(unsigned size_mb);
+void tt_clear(void);
+void tt_new_search(void);
+bool tt_probe(uint64_t key, tt_result_t* result);
+void tt_store(uint64_t key, int depth, int score, tt_bound_t bound, const move_t* move);
+void tt_get_stats(tt_stats_t* stats);
@@ -2,10 +2,14 @@
 
 #include <errno.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 
 #define PRINTF_LIKE(fmtarg, firstvararg) __attribute__((format(printf, fmtarg, firstvararg)))
 
 PRINTF_LIKE(2, 3)
 void raise_error(int err, const char* fmt, ...);
+uint64_t monotonic_us(void);
+uint64_t random_next(uint64_t* state);
+uint64_t random_seed(void);
 
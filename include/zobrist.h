@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "board.h"
+
+
+void zobrist_init(void);
+uint64_t zobrist_piece(colour_t colour, piece_type_t type, int sq);
+uint64_t zobrist_castling(unsigned rights);
+uint64_t zobrist_en_passant(int sq);
+uint64_t zobrist_side(void);
+uint64_t zobrist_hash(const board_t* b, colour_t turn);
@@ -0,0 +1,43 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+
+bool arena_reserve(arena_t* arena, size_t size)
+{
+    /* only ever grows, so a long session settles on one block */
+    if (arena->base && arena->size >= size)
+    {
+        arena->used = 0;
+        return true;
+    }
+    unsigned char* base = malloc(size);
+    if (!base)
+        return false;
+    free(arena->base);
+    arena->base = base;
+    arena->size = size;
+    arena->used = 0;
+    return true;
+}
+
+
+void arena_destroy(arena_t* arena)
+{
+    free(arena->base);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+
+void* arena_alloc(arena_t* arena, size_t size)
+{
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!arena->base || start > arena->size || size > arena->size - start)
+        return NULL;
+    arena->used = start + size;
+    return arena->base + start;
+}
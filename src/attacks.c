@@ -0,0 +1,170 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attacks.h"
+#include "util.h"
+
+
+static const int knight_steps[][2] =
+{
+    { 1,  2}, { 2,  1}, { 2, -1}, { 1, -2},
+    {-1, -2}, {-2, -1}, {-2,  1}, {-1,  2},
+};
+
+static const int king_steps[][2] =
+{
+    { 1,  0}, { 1,  1}, { 0,  1}, {-1,  1},
+    {-1,  0}, {-1, -1}, { 0, -1}, { 1, -1},
+};
+
+/* in direction_t order */
+static const int direction_steps[ATTACK_DIRECTIONS][2] =
+{
+    { 1,  0}, { 0,  1}, {-1,  0}, { 0, -1},
+    { 1,  1}, {-1,  1}, {-1, -1}, { 1, -1},
+};
+
+#define STEP_COUNT(_steps)      (sizeof(_steps) / sizeof(_steps[0]))
+
+
+/* only ever grows at the head, so it is read without the lock, which just
+ * keeps two threads from building the same size at once */
+static _Atomic(attack_tables_t*) tables_list = NULL;
+static pthread_mutex_t tables_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void* alloc_table(size_t count, size_t size)
+{
+    void* table = calloc(count, size);
+    if (!table)
+        raise_error(ENOMEM, "failed to allocate attack table"); /* exits here */
+    return table;
+}
+
+
+static int square_at(const attack_tables_t* t, int x, int y)
+{
+    if (x < 0 || x >= t->width || y < 0 || y >= t->height)
+        return ATTACK_LIST_END;
+    return (t->height - 1 - y) * t->width + x;
+}
+
+
+static bitboard_t list_mask(const int* list)
+{
+    bitboard_t mask = 0;
+    for (; *list != ATTACK_LIST_END; list++)
+        mask |= bitboard_square(*list);
+    return mask;
+}
+
+
+static void build_step_list(const attack_tables_t* t, int* list, int x, int y, const int steps[][2], unsigned num_steps)
+{
+    for (unsigned i = 0; i < num_steps; i++)
+    {
+        int sq = square_at(t, x + steps[i][0], y + steps[i][1]);
+        if (sq != ATTACK_LIST_END)
+            *list++ = sq;
+    }
+    *list = ATTACK_LIST_END;
+}
+
+
+static attack_tables_t* build_tables(int width, int height)
+{
+    attack_tables_t* t = alloc_table(1, sizeof(attack_tables_t));
+    int squares = width * height;
+    t->width = width;
+    t->height = height;
+    t->ray_len = (width > height ? width : height);
+    t->knight = alloc_table(squares * 9, sizeof(int));
+    t->king = alloc_table(squares * 9, sizeof(int));
+    for (int c = COLOUR_WHITE; c < COLOUR_COUNT; c++)
+        t->pawn[c] = alloc_table(squares * 3, sizeof(int));
+    for (int d = 0; d < ATTACK_DIRECTIONS; d++)
+    {
+        t->rays[d] = alloc_table(squares * t->ray_len, sizeof(int));
+        t->ray_ascending[d] = direction_steps[d][0] - direction_steps[d][1] * width > 0;
+    }
+
+    for (int sq = 0; sq < squares; sq++)
+    {
+        int x = sq % width;
+        int y = height - 1 - sq / width;
+        build_step_list(t, &t->knight[sq * 9], x, y, knight_steps, STEP_COUNT(knight_steps));
+        build_step_list(t, &t->king[sq * 9], x, y, king_steps, STEP_COUNT(king_steps));
+        for (int c = COLOUR_WHITE; c < COLOUR_COUNT; c++)
+        {
+            int dy = (c == COLOUR_WHITE) ? 1 : -1;
+            const int pawn_steps[][2] = { {-1, dy}, {1, dy} };
+            build_step_list(t, &t->pawn[c][sq * 3], x, y, pawn_steps, STEP_COUNT(pawn_steps));
+        }
+        for (int d = 0; d < ATTACK_DIRECTIONS; d++)
+        {
+            int* ray = &t->rays[d][sq * t->ray_len];
+            int step_x = direction_steps[d][0];
+            int step_y = direction_steps[d][1];
+            for (int to = square_at(t, x + step_x, y + step_y), n = 2;
+                 to != ATTACK_LIST_END;
+                 to = square_at(t, x + n * step_x, y + n * step_y), n++)
+            {
+                *ray++ = to;
+            }
+            *ray = ATTACK_LIST_END;
+        }
+    }
+
+    if (squares > BITBOARD_MAX_SQUARES)
+        return t;
+
+    t->knight_mask = alloc_table(squares, sizeof(bitboard_t));
+    t->king_mask = alloc_table(squares, sizeof(bitboard_t));
+    for (int c = COLOUR_WHITE; c < COLOUR_COUNT; c++)
+        t->pawn_mask[c] = alloc_table(squares, sizeof(bitboard_t));
+    for (int d = 0; d < ATTACK_DIRECTIONS; d++)
+        t->ray_mask[d] = alloc_table(squares, sizeof(bitboard_t));
+    for (int sq = 0; sq < squares; sq++)
+    {
+        t->knight_mask[sq] = list_mask(attacks_knight(t, sq));
+        t->king_mask[sq] = list_mask(attacks_king(t, sq));
+        for (int c = COLOUR_WHITE; c < COLOUR_COUNT; c++)
+            t->pawn_mask[c][sq] = list_mask(attacks_pawn(t, c, sq));
+        for (int d = 0; d < ATTACK_DIRECTIONS; d++)
+            t->ray_mask[d][sq] = list_mask(attacks_ray(t, d, sq));
+    }
+    return t;
+}
+
+
+static attack_tables_t* find_tables(attack_tables_t* list, int width, int height)
+{
+    for (attack_tables_t* t = list; t; t = t->next)
+    {
+        if (t->width == width && t->height == height)
+            return t;
+    }
+    return NULL;
+}
+
+
+const attack_tables_t* attack_tables_get(int width, int height)
+{
+    /* tables are built once per board size and kept for the process */
+    attack_tables_t* t = find_tables(atomic_load(&tables_list), width, height);
+    if (t)
+        return t;
+    pthread_mutex_lock(&tables_lock);
+    attack_tables_t* head = atomic_load(&tables_list);
+    t = find_tables(head, width, height);
+    if (!t)
+    {
+        t = build_tables(width, height);
+        t->next = head;
+        atomic_store(&tables_list, t);
+    }
+    pthread_mutex_unlock(&tables_lock);
+    return t;
+}
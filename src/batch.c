@@ -0,0 +1,350 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "board.h"
+#include "fen.h"
+#include "game.h"
+#include "move.h"
+#include "tt.h"
+#include "util.h"
+
+#include "movegen/search.h"
+
+
+#define BATCH_BOARD_SIZE        8
+#define BATCH_UCI_LEN           8
+
+
+typedef enum
+{
+    LINE_COPIED,
+    LINE_ANALYSED,
+    LINE_INVALID
+} line_result_t;
+
+typedef struct
+{
+    char line[BATCH_LINE_LEN];
+    char result[BATCH_RESULT_LEN];
+    bool truncated;
+    bool done;
+} batch_slot_t;
+
+/* Lines move through a ring of slots by sequence number: the reader fills
+ * slot read, workers claim them in order and analyse them unlocked, and
+ * whichever worker completes the oldest outstanding line writes out every
+ * finished line from there on. The reader waits for the writer once the
+ * window is full. */
+typedef struct
+{
+    FILE* out;
+    batch_slot_t slots[BATCH_WINDOW];
+    long read;
+    long claimed;
+    long written;
+    bool eof;
+    batch_stats_t stats;
+    pthread_mutex_t lock;
+    pthread_cond_t work;        /* a line was read, or the input ended */
+    pthread_cond_t space;       /* a line was written out */
+} batch_t;
+
+typedef struct
+{
+    batch_t* batch;
+    game_t* game;
+    pthread_t thread;
+} batch_worker_t;
+
+
+static const char* const status_names[] = { "ongoing", "check", "checkmate", "stalemate", "repetition", "fifty_moves" };
+
+
+static bool has_both_kings(const board_t* b)
+{
+    int kings[COLOUR_COUNT] = { 0 };
+    for (int i = 0; i < b->width * b->height; i++)
+    {
+        if (b->squares[i].type == PIECE_TYPE_KING)
+            kings[b->squares[i].colour]++;
+    }
+    return kings[COLOUR_WHITE] == 1 && kings[COLOUR_BLACK] == 1;
+}
+
+
+static int append(char* out, int pos, int size, const char* fmt, ...) PRINTF_LIKE(4, 5);
+
+
+static int append(char* out, int pos, int size, const char* fmt, ...)
+{
+    if (pos >= size)
+        return pos;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(out + pos, size - pos, fmt, ap);
+    va_end(ap);
+    return (n < 0 || pos + n >= size) ? size - 1 : pos + n;
+}
+
+
+static int append_operations(const char* ops, char* out, int pos, int size)
+{
+    /* keeps the input's operations except the ones analysis rewrites;
+     * semicolons inside quoted operands don't end an operation */
+    while (*ops)
+    {
+        while (*ops == ' ' || *ops == '\t' || *ops == ';')
+            ops++;
+        const char* start = ops;
+        bool quoted = false;
+        for (; *ops && (quoted || *ops != ';'); ops++)
+        {
+            if (*ops == '"')
+                quoted = !quoted;
+        }
+        size_t len = (size_t)(ops - start);
+        while (len && isspace((unsigned char)start[len - 1]))
+            len--;
+        if (!len)
+            continue;
+        size_t opcode = strcspn(start, " \t;");
+        if ((opcode == 2 && (!strncmp(start, "bm", 2) || !strncmp(start, "ce", 2)))
+            || (opcode == 6 && !strncmp(start, "status", 6)))
+        {
+            continue;
+        }
+        pos = append(out, pos, size, " %.*s;", (int)len, start);
+    }
+    return pos;
+}
+
+
+static line_result_t analyse_line(game_t* game, const char* line, bool truncated, char* out, int size)
+{
+    size_t len = strcspn(line, "\r\n");
+    size_t indent = strspn(line, " \t");
+    if (indent == len || line[indent] == '#')
+    {
+        /* kept so output lines still match input lines one to one */
+        snprintf(out, size, "%.*s\n", (int)len, line);
+        return LINE_COPIED;
+    }
+
+    /* a position needs at least its placement and side to move */
+    fen_state_t state;
+    int position = truncated ? -1 : game_set_fen(game, line + indent, &state);
+    if (position < 0 || state.fields < 2 || !has_both_kings(game_get_board(game)))
+    {
+        snprintf(out, size, "%.*s status invalid;\n", (int)len, line);
+        return LINE_INVALID;
+    }
+
+    colour_t turn = state.turn;
+    game_status_t status = game_get_status(game);
+
+    int pos = append(out, 0, size, "%.*s", (int)position, line + indent);
+    if (status == STATUS_ONGOING || status == STATUS_CHECK)
+    {
+        int score = movegen_search_evaluate(game_get_board(game), turn);
+        move_t m;
+        char uci[BATCH_UCI_LEN] = "0000";
+        if (game_get_best_move(game, &m))
+            move_to_uci(game_get_board(game), &m, uci, sizeof(uci));
+        pos = append(out, pos, size, " bm %s; ce %d;", uci, score);
+    }
+    pos = append(out, pos, size, " status %s;", status_names[status]);
+    pos = append_operations(line + indent + position, out, pos, size);
+    /* a result cut short by the buffer still ends its line */
+    if (pos >= size - 1)
+        pos = size - 2;
+    out[pos++] = '\n';
+    out[pos] = '\0';
+    return LINE_ANALYSED;
+}
+
+
+static bool read_line(FILE* in, char* line, bool* truncated)
+{
+    /* overlong lines are read to their end and reported as invalid */
+    if (!fgets(line, BATCH_LINE_LEN, in))
+        return false;
+    *truncated = false;
+    size_t len = strlen(line);
+    if (len && line[len - 1] != '\n' && !feof(in))
+    {
+        *truncated = true;
+        int c;
+        while ((c = fgetc(in)) != EOF && c != '\n')
+            ;
+    }
+    return true;
+}
+
+
+static void count_line(batch_stats_t* stats, line_result_t result)
+{
+    if (result == LINE_ANALYSED)
+        stats->positions++;
+    else if (result == LINE_INVALID)
+        stats->invalid++;
+}
+
+
+static void flush_ready(batch_t* b)
+{
+    /* called with the lock held */
+    while (b->written < b->claimed)
+    {
+        batch_slot_t* slot = &b->slots[b->written % BATCH_WINDOW];
+        if (!slot->done)
+            break;
+        fputs(slot->result, b->out);
+        slot->done = false;
+        b->written++;
+        pthread_cond_signal(&b->space);
+    }
+}
+
+
+static void* worker_main(void* arg)
+{
+    batch_worker_t* w = arg;
+    batch_t* b = w->batch;
+    pthread_mutex_lock(&b->lock);
+    for (;;)
+    {
+        while (b->claimed == b->read && !b->eof)
+            pthread_cond_wait(&b->work, &b->lock);
+        if (b->claimed == b->read)
+            break;
+        batch_slot_t* slot = &b->slots[b->claimed++ % BATCH_WINDOW];
+        pthread_mutex_unlock(&b->lock);
+
+        line_result_t result = analyse_line(w->game, slot->line, slot->truncated,
+            slot->result, sizeof(slot->result));
+
+        pthread_mutex_lock(&b->lock);
+        count_line(&b->stats, result);
+        slot->done = true;
+        flush_ready(b);
+    }
+    pthread_mutex_unlock(&b->lock);
+    return NULL;
+}
+
+
+static void analyse_inline(batch_t* b, FILE* in, game_t* game)
+{
+    /* without threads, as in the default wasm build, one line at a time */
+    batch_slot_t* slot = &b->slots[0];
+    while (read_line(in, slot->line, &slot->truncated))
+    {
+        line_result_t result = analyse_line(game, slot->line, slot->truncated,
+            slot->result, sizeof(slot->result));
+        count_line(&b->stats, result);
+        fputs(slot->result, b->out);
+    }
+}
+
+
+static int start_workers(batch_t* b, batch_worker_t* workers, int count, const game_config_t* cfg)
+{
+    int started = 0;
+    for (; started < count; started++)
+    {
+        batch_worker_t* w = &workers[started];
+        w->batch = b;
+        w->game = game_create(cfg);
+        if (pthread_create(&w->thread, NULL, worker_main, w))
+        {
+            game_destroy(w->game);
+            break;
+        }
+    }
+    return started;
+}
+
+
+bool batch_analyse(FILE* in, FILE* out, int threads, const search_limits_t* limits, batch_stats_t* stats)
+{
+    if (threads < 1)
+        threads = 1;
+    if (threads > BATCH_MAX_THREADS)
+        threads = BATCH_MAX_THREADS;
+    batch_t* b = calloc(1, sizeof(batch_t));
+    batch_worker_t* workers = calloc(threads, sizeof(batch_worker_t));
+    if (!b || !workers)
+    {
+        free(b);
+        free(workers);
+        return false;
+    }
+    b->out = out;
+    pthread_mutex_init(&b->lock, NULL);
+    pthread_cond_init(&b->work, NULL);
+    pthread_cond_init(&b->space, NULL);
+
+    /* the positions are spread over the threads, each searches alone */
+    game_config_t cfg = {BATCH_BOARD_SIZE, BATCH_BOARD_SIZE, true, true, true};
+    cfg.search = *limits;
+    cfg.search.threads = 1;
+
+    /* shared state the workers would otherwise race to create */
+    tt_init();
+    uint64_t start = monotonic_us();
+    int started = start_workers(b, workers, threads, &cfg);
+    if (!started)
+    {
+        game_t* game = game_create(&cfg);
+        analyse_inline(b, in, game);
+        game_destroy(game);
+    }
+    else
+    {
+        for (;;)
+        {
+            /* the slot being filled was written out a window ago, no worker
+             * looks at it until read moves past it */
+            pthread_mutex_lock(&b->lock);
+            while (b->read - b->written >= BATCH_WINDOW)
+                pthread_cond_wait(&b->space, &b->lock);
+            pthread_mutex_unlock(&b->lock);
+            batch_slot_t* slot = &b->slots[b->read % BATCH_WINDOW];
+            if (!read_line(in, slot->line, &slot->truncated))
+                break;
+            pthread_mutex_lock(&b->lock);
+            b->read++;
+            pthread_cond_signal(&b->work);
+            pthread_mutex_unlock(&b->lock);
+        }
+        pthread_mutex_lock(&b->lock);
+        b->eof = true;
+        pthread_cond_broadcast(&b->work);
+        pthread_mutex_unlock(&b->lock);
+        for (int i = 0; i < started; i++)
+        {
+            pthread_join(workers[i].thread, NULL);
+            game_destroy(workers[i].game);
+        }
+    }
+    b->stats.elapsed_us = monotonic_us() - start;
+
+    bool ok = !ferror(in) && !ferror(out) && fflush(out) == 0;
+    if (stats)
+        *stats = b->stats;
+    pthread_cond_destroy(&b->space);
+    pthread_cond_destroy(&b->work);
+    pthread_mutex_destroy(&b->lock);
+    free(workers);
+    free(b);
+    return ok;
+}
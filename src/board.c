@@ -2,6 +2,9 @@
 #include <string.h>
 
 #include "board.h"
+#include "attacks.h"
+#include "stats.h"
+#include "zobrist.h"
 
 
 board_t* create_board(int width, int height)
@@ -10,6 +13,13 @@ board_t* create_board(int width, int height)
     b->width = width;
     b->height = height;
     b->squares = calloc(width * height, sizeof(piece_t));
+    b->attacks = attack_tables_get(width, height);
+    b->castling = 0;
+    b->en_passant = -1;
+    b->hash = 0;
+    zobrist_init();
+    b->has_bitboards = width * height <= BITBOARD_MAX_SQUARES;
+    sync_bitboards(b);
     return b;
 }
 
@@ -23,31 +33,71 @@ void destroy_board(board_t* b)
 }
 
 
-bool copy_board(board_t* new_b, board_t* b)
+static void copy_bitboards(board_t* new_b, const board_t* b)
+{
+    if (!b->has_bitboards)
+        return;
+    memcpy(new_b->pieces, b->pieces, sizeof(b->pieces));
+    memcpy(new_b->occupied, b->occupied, sizeof(b->occupied));
+}
+
+
+bool copy_board(board_t* new_b, const board_t* b)
 {
     if (new_b->height != b->height
         || new_b->width != b->width)
     {
         return false;
     }
+    STATS_COUNT(STAT_BOARD_COPIES);
     unsigned mem_squares_size = sizeof(piece_t) * new_b->height * new_b->width;
     memcpy(new_b->squares, b->squares, mem_squares_size);
+    copy_bitboards(new_b, b);
+    new_b->castling = b->castling;
+    new_b->en_passant = b->en_passant;
+    new_b->hash = b->hash;
     return true;
 }
 
 
-board_t* duplicate_board(board_t* b)
+board_t* duplicate_board(const board_t* b)
 {
+    STATS_COUNT(STAT_BOARD_COPIES);
     board_t* board = malloc(sizeof(board_t));
     board->height = b->height;
     board->width = b->width;
+    board->attacks = b->attacks;
+    board->has_bitboards = b->has_bitboards;
+    board->castling = b->castling;
+    board->en_passant = b->en_passant;
+    board->hash = b->hash;
     unsigned mem_squares_size = sizeof(piece_t) * board->height * board->width;
     board->squares = malloc(mem_squares_size);
     memcpy(board->squares, b->squares, mem_squares_size);
+    copy_bitboards(board, b);
     return board;
 }
 
 
+
+bool boards_equal(const board_t* a, const board_t* b)
+{
+    /* same pieces, masks, rights and hash */
+    if (a->width != b->width || a->height != b->height)
+        return false;
+    if (memcmp(a->squares, b->squares, sizeof(piece_t) * a->width * a->height))
+        return false;
+    if (a->has_bitboards
+        && (memcmp(a->pieces, b->pieces, sizeof(a->pieces))
+            || memcmp(a->occupied, b->occupied, sizeof(a->occupied))))
+    {
+        return false;
+    }
+    return a->castling == b->castling
+        && a->en_passant == b->en_passant
+        && a->hash == b->hash;
+}
+
 piece_t* get_piece(const board_t* b, int index)
 {
     return &b->squares[index];
@@ -56,6 +106,23 @@ piece_t* get_piece(const board_t* b, int index)
 
 void set_piece(board_t* b, int index, piece_t* p)
 {
+    piece_t* old = &b->squares[index];
+    b->hash ^= zobrist_piece(old->colour, old->type, index)
+        ^ zobrist_piece(p->colour, p->type, index);
+    if (b->has_bitboards)
+    {
+        bitboard_t bit = bitboard_square(index);
+        if (old->type != PIECE_TYPE_EMPTY)
+        {
+            b->pieces[old->colour][old->type] &= ~bit;
+            b->occupied[old->colour] &= ~bit;
+        }
+        if (p->type != PIECE_TYPE_EMPTY)
+        {
+            b->pieces[p->colour][p->type] |= bit;
+            b->occupied[p->colour] |= bit;
+        }
+    }
     memcpy(&b->squares[index], p, sizeof(piece_t));
 }
 
@@ -68,4 +135,48 @@ void clear_board(board_t* b)
         b->squares[i].type = PIECE_TYPE_EMPTY;
         b->squares[i].colour = COLOUR_NONE;
     }
+    b->castling = 0;
+    b->en_passant = -1;
+    b->hash = 0;
+    sync_bitboards(b);
+}
+
+
+void sync_bitboards(board_t* b)
+{
+    /* rebuilds the masks after the square array was written directly */
+    if (!b->has_bitboards)
+        return;
+    memset(b->pieces, 0, sizeof(b->pieces));
+    memset(b->occupied, 0, sizeof(b->occupied));
+    int size = b->width * b->height;
+    for (int i = 0; i < size; i++)
+    {
+        piece_t* p = &b->squares[i];
+        if (p->type == PIECE_TYPE_EMPTY)
+            continue;
+        b->pieces[p->colour][p->type] |= bitboard_square(i);
+        b->occupied[p->colour] |= bitboard_square(i);
+    }
+}
+
+
+int find_next_piece(const board_t* b, colour_t colour, int from)
+{
+    /* first square at or after from holding a piece of colour, or -1 */
+    int size = b->width * b->height;
+    if (from >= size)
+        return -1;
+    if (b->has_bitboards)
+    {
+        bitboard_t bb = b->occupied[colour] & (~(bitboard_t)0 << from);
+        return bb ? bitboard_lsb(bb) : -1;
+    }
+    for (int i = from; i < size; i++)
+    {
+        piece_t* p = &b->squares[i];
+        if (p->type != PIECE_TYPE_EMPTY && p->colour == colour)
+            return i;
+    }
+    return -1;
 }
@@ -0,0 +1,231 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef __TO_WEBASM__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "book.h"
+#include "util.h"
+
+
+#define BOOK_MAX_CANDIDATES     MOVE_LIST_CAPACITY
+
+
+typedef enum
+{
+    BOOK_NONE,
+    BOOK_MAPPED,
+    BOOK_OWNED
+} book_storage_t;
+
+
+/* the book is read straight out of the file image, nothing is parsed */
+static const unsigned char* book_data = NULL;
+static size_t book_size = 0;
+static size_t book_entries = 0;
+static book_storage_t storage = BOOK_NONE;
+
+
+static uint64_t read_u64(const unsigned char* p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+
+static uint32_t read_u32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+static unsigned read_u16(const unsigned char* p)
+{
+    return (unsigned)p[0] | (unsigned)p[1] << 8;
+}
+
+
+static const unsigned char* entry_at(size_t index)
+{
+    return book_data + BOOK_HEADER_SIZE + index * BOOK_ENTRY_SIZE;
+}
+
+
+static bool attach(const unsigned char* data, size_t size, book_storage_t kind)
+{
+    /* only the header is checked, the entries are trusted to be sorted */
+    if (size < BOOK_HEADER_SIZE || memcmp(data, BOOK_MAGIC, BOOK_MAGIC_NAME_LEN))
+    {
+        printf("not an opening book\n");
+        return false;
+    }
+    if (memcmp(data, BOOK_MAGIC, strlen(BOOK_MAGIC)))
+    {
+        /* its positions were hashed differently, none would be found */
+        printf("opening book is from another version, rebuild it with mkbook\n");
+        return false;
+    }
+    size_t count = read_u32(data + strlen(BOOK_MAGIC));
+    if ((size - BOOK_HEADER_SIZE) / BOOK_ENTRY_SIZE < count)
+    {
+        printf("opening book is truncated\n");
+        return false;
+    }
+    book_close();
+    book_data = data;
+    book_size = size;
+    book_entries = count;
+    storage = kind;
+    return true;
+}
+
+
+#ifndef __TO_WEBASM__
+bool book_open(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("could not open book '%s'\n", path);
+        return false;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        printf("could not map book '%s'\n", path);
+        return false;
+    }
+    if (!attach(data, (size_t)st.st_size, BOOK_MAPPED))
+    {
+        munmap(data, (size_t)st.st_size);
+        return false;
+    }
+    return true;
+}
+#else
+bool book_open(const char* path)
+{
+    /* the page fetches the book itself and hands it over with book_adopt */
+    printf("no book files in the browser: '%s'\n", path);
+    return false;
+}
+#endif
+
+
+bool book_adopt(void* data, size_t size)
+{
+    /* takes ownership of a malloc'd copy of the file, freed on close */
+    if (!attach(data, size, BOOK_OWNED))
+    {
+        free(data);
+        return false;
+    }
+    return true;
+}
+
+
+void book_close(void)
+{
+#ifndef __TO_WEBASM__
+    if (storage == BOOK_MAPPED)
+        munmap((void*)book_data, book_size);
+#endif
+    if (storage == BOOK_OWNED)
+        free((void*)book_data);
+    book_data = NULL;
+    book_size = 0;
+    book_entries = 0;
+    storage = BOOK_NONE;
+}
+
+
+bool book_loaded(void)
+{
+    return storage != BOOK_NONE;
+}
+
+
+size_t book_entry_count(void)
+{
+    return book_entries;
+}
+
+
+static size_t lower_bound(uint64_t key)
+{
+    size_t lo = 0;
+    size_t hi = book_entries;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (read_u64(entry_at(mid)) < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+static const move_t* find_legal(const move_list_t* legal_moves, const move_t* m)
+{
+    for (int i = 0; i < legal_moves->count; i++)
+    {
+        if (move_equal(&legal_moves->moves[i], m))
+            return &legal_moves->moves[i];
+    }
+    return NULL;
+}
+
+
+bool book_probe(uint64_t key, const move_list_t* legal_moves, uint64_t* random_state, move_t* move)
+{
+    /* picks among the position's book moves in proportion to their weight;
+     * moves that aren't legal here, from a hash collision or another board
+     * size, are skipped */
+    if (!book_entries)
+        return false;
+    const move_t* candidates[BOOK_MAX_CANDIDATES];
+    unsigned weights[BOOK_MAX_CANDIDATES];
+    int count = 0;
+    unsigned total = 0;
+    for (size_t i = lower_bound(key); i < book_entries && count < BOOK_MAX_CANDIDATES; i++)
+    {
+        const unsigned char* e = entry_at(i);
+        if (read_u64(e) != key)
+            break;
+        move_t m = move_encode((int)read_u16(e + 8), (int)read_u16(e + 10), (piece_type_t)e[12], MOVE_FLAG_NONE);
+        const move_t* legal = find_legal(legal_moves, &m);
+        unsigned weight = read_u16(e + 14);
+        if (!legal || !weight)
+            continue;
+        candidates[count] = legal;
+        weights[count++] = weight;
+        total += weight;
+    }
+    if (!count)
+        return false;
+
+    unsigned pick = (unsigned)(random_next(random_state) % total);
+    int chosen = 0;
+    while (pick >= weights[chosen])
+        pick -= weights[chosen++];
+    *move = *candidates[chosen];
+    return true;
+}
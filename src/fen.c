@@ -2,156 +2,452 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <stdbool.h>
 
 #include "fen.h"
 #include "move.h"
+#include "rules.h"
+#include "zobrist.h"
 
 
 #define INDEX_INVALID           -1
+#define FEN_MAX_DIGITS          9       /* keeps counts inside an int */
+#define FEN_MAX_FILES           26
 
 
-static piece_t fen_char_to_piece(char c)
+/* letters by colour and type for writing, and back for parsing; the
+ * zeroed entries of the parse table are the invalid characters */
+static const char piece_chars[COLOUR_COUNT][PIECE_TYPE_COUNT] =
 {
-    piece_t p;
-    p.colour = isupper(c) ? COLOUR_WHITE : COLOUR_BLACK;
-    switch (tolower(c))
-    {
-        case 'p':
-            p.type = PIECE_TYPE_PAWN;
-            break;
-        case 'n':
-            p.type = PIECE_TYPE_KNIGHT;
-            break;
-        case 'b':
-            p.type = PIECE_TYPE_BISHOP;
-            break;
-        case 'r':
-            p.type = PIECE_TYPE_ROOK;
-            break;
-        case 'q':
-            p.type = PIECE_TYPE_QUEEN;
-            break;
-        case 'k':
-            p.type = PIECE_TYPE_KING;
-            break;
-        default:
-            p.type = PIECE_TYPE_EMPTY;
-            p.colour = COLOUR_NONE;
-            break;
-    }
+    [COLOUR_WHITE] = { ' ', 'P', 'N', 'B', 'R', 'Q', 'K' },
+    [COLOUR_BLACK] = { ' ', 'p', 'n', 'b', 'r', 'q', 'k' },
+};
+
+static const piece_t char_pieces[128] =
+{
+    ['P'] = { PIECE_TYPE_PAWN, COLOUR_WHITE },
+    ['N'] = { PIECE_TYPE_KNIGHT, COLOUR_WHITE },
+    ['B'] = { PIECE_TYPE_BISHOP, COLOUR_WHITE },
+    ['R'] = { PIECE_TYPE_ROOK, COLOUR_WHITE },
+    ['Q'] = { PIECE_TYPE_QUEEN, COLOUR_WHITE },
+    ['K'] = { PIECE_TYPE_KING, COLOUR_WHITE },
+    ['p'] = { PIECE_TYPE_PAWN, COLOUR_BLACK },
+    ['n'] = { PIECE_TYPE_KNIGHT, COLOUR_BLACK },
+    ['b'] = { PIECE_TYPE_BISHOP, COLOUR_BLACK },
+    ['r'] = { PIECE_TYPE_ROOK, COLOUR_BLACK },
+    ['q'] = { PIECE_TYPE_QUEEN, COLOUR_BLACK },
+    ['k'] = { PIECE_TYPE_KING, COLOUR_BLACK },
+};
+
+static const struct
+{
+    char c;
+    unsigned bit;
+} castle_chars[] =
+{
+    { 'K', CASTLE_WHITE_KING },
+    { 'Q', CASTLE_WHITE_QUEEN },
+    { 'k', CASTLE_BLACK_KING },
+    { 'q', CASTLE_BLACK_QUEEN },
+};
+
+#define CASTLE_CHAR_COUNT       (int)(sizeof(castle_chars) / sizeof(castle_chars[0]))
+
+
+static bool is_field_end(char c)
+{
+    /* fields end at a blank, and the whole position at an EPD operation */
+    return c == '\0' || c == ' ' || c == '\t' || c == ';' || c == '\r' || c == '\n';
+}
+
+
+static const char* skip_blanks(const char* p)
+{
+    while (*p == ' ' || *p == '\t')
+        p++;
     return p;
 }
 
 
-static char piece_to_fen_char(piece_t p)
+static const char* parse_count(const char* p, int* out)
 {
-    char c = '?';
-    switch (p.type)
+    /* a decimal number of at most FEN_MAX_DIGITS digits */
+    int n = 0;
+    int digits = 0;
+    for (; *p >= '0' && *p <= '9'; p++)
     {
-        case PIECE_TYPE_PAWN:
-            c = 'p';
-            break;
-        case PIECE_TYPE_KNIGHT:
-            c = 'n';
-            break;
-        case PIECE_TYPE_BISHOP:
-            c = 'b';
-            break;
-        case PIECE_TYPE_ROOK:
-            c = 'r';
-            break;
-        case PIECE_TYPE_QUEEN:
-            c = 'q';
-            break;
-        case PIECE_TYPE_KING:
-            c = 'k';
-            break;
-        case PIECE_TYPE_EMPTY:
-            c = ' ';
-            break;
-        default:
-            break;
+        if (++digits > FEN_MAX_DIGITS)
+            return NULL;
+        n = n * 10 + (*p - '0');
     }
-    if (p.colour == COLOUR_WHITE)
-        c = toupper(c);
-    return c;
+    if (!digits)
+        return NULL;
+    *out = n;
+    return p;
 }
 
 
-board_t* parse_fen(const char* fen, colour_t* out_turn)
+static const char* parse_placement(board_t* b, const char* p)
 {
-    int width = 8;
-    int height = 8;
-    board_t* b = create_board(width, height);
+    /* straight into the board, rank by rank from index 0 */
     int rank = 0;
     int file = 0;
-    const char* p = fen;
-    while (*p && rank < height && *p != ' ')
+    for (; !is_field_end(*p); p++)
     {
-        if (*p == '/')
+        unsigned char c = (unsigned char)*p;
+        if (c == '/')
         {
-            rank++;
+            if (file != b->width || ++rank >= b->height)
+                return NULL;
             file = 0;
         }
-        else if (isdigit(*p))
+        else if (c >= '1' && c <= '9')
         {
-            file += *p - '0';
+            int run = 0;
+            const char* next = parse_count(p, &run);
+            if (!next || run > b->width - file)
+                return NULL;
+            file += run;
+            p = next - 1;
         }
         else
         {
-            int idx = rank * width + file;
-            b->squares[idx] = fen_char_to_piece(*p);
+            if (c >= sizeof(char_pieces) / sizeof(char_pieces[0])
+                || char_pieces[c].type == PIECE_TYPE_EMPTY || file >= b->width)
+            {
+                return NULL;
+            }
+            piece_t piece = char_pieces[c];
+            set_piece(b, rank * b->width + file, &piece);
             file++;
         }
-        p++;
     }
-    while (*p && *p == ' ')
-        p++;
-    if (*p == 'w')
-        *out_turn = COLOUR_WHITE;
-    else if (*p == 'b')
-        *out_turn = COLOUR_BLACK;
-    return b;
+    return (rank == b->height - 1 && file == b->width) ? p : NULL;
 }
 
 
-int generate_fen(const board_t* b, colour_t turn, char* out_fen, int max_len)
+static const char* parse_turn(const char* p, colour_t* turn)
+{
+    if ((*p != 'w' && *p != 'b') || !is_field_end(p[1]))
+        return NULL;
+    *turn = (*p == 'w') ? COLOUR_WHITE : COLOUR_BLACK;
+    return p + 1;
+}
+
+
+static const char* parse_castling(const char* p, unsigned* castling)
+{
+    /* '-' or each of KQkq at most once */
+    if (*p == '-')
+        return is_field_end(p[1]) ? p + 1 : NULL;
+    unsigned rights = 0;
+    for (; !is_field_end(*p); p++)
+    {
+        int i = 0;
+        while (i < CASTLE_CHAR_COUNT && castle_chars[i].c != *p)
+            i++;
+        if (i == CASTLE_CHAR_COUNT || (rights & castle_chars[i].bit))
+            return NULL;
+        rights |= castle_chars[i].bit;
+    }
+    if (!rights)
+        return NULL;
+    *castling = rights;
+    return p;
+}
+
+
+static const char* parse_en_passant(const board_t* b, const char* p, colour_t turn, int* square)
+{
+    /* '-' or the square the opponent's pawn skipped */
+    if (*p == '-')
+        return is_field_end(p[1]) ? p + 1 : NULL;
+    int file = *p - 'a';
+    int rank = 0;
+    if (file < 0 || file >= b->width)
+        return NULL;
+    p = parse_count(p + 1, &rank);
+    if (!p || !is_field_end(*p) || rank != ((turn == COLOUR_WHITE) ? b->height - 2 : 3))
+        return NULL;
+    *square = (b->height - rank) * b->width + file;
+    return p;
+}
+
+
+static const char* parse_clock(const char* p, int* clock)
 {
-    int width = b->width;
-    int height = b->height;
-    int pos = 0;
-    for (int r = 0; r < height; r++)
+    p = parse_count(p, clock);
+    return (p && is_field_end(*p)) ? p : NULL;
+}
+
+
+static unsigned infer_castling(const board_t* b)
+{
+    /* for FENs without a castling field */
+    unsigned rights = 0;
+    for (colour_t c = COLOUR_WHITE; c <= COLOUR_BLACK; c++)
     {
-        int empty_count = 0;
-        for (int f = 0; f < width; f++)
+        const piece_t* rank = &b->squares[(c == COLOUR_WHITE) ? (b->height - 1) * b->width : 0];
+        bool king = false;
+        for (int f = 0; f < b->width && !king; f++)
+            king = rank[f].type == PIECE_TYPE_KING && rank[f].colour == c;
+        if (!king)
+            continue;
+        unsigned shift = (c == COLOUR_WHITE) ? 0 : 2;
+        if (rank[b->width - 1].type == PIECE_TYPE_ROOK && rank[b->width - 1].colour == c)
+            rights |= CASTLE_WHITE_KING << shift;
+        if (rank[0].type == PIECE_TYPE_ROOK && rank[0].colour == c)
+            rights |= CASTLE_WHITE_QUEEN << shift;
+    }
+    return rights;
+}
+
+
+void fen_state_init(fen_state_t* state, colour_t turn)
+{
+    state->turn = turn;
+    state->halfmove_clock = 0;
+    state->fullmove_number = 1;
+    state->fields = 0;
+}
+
+
+int fen_parse(board_t* b, const char* fen, fen_state_t* state)
+{
+    /* Reads a FEN into an existing board of the same dimensions in one pass,
+     * without allocating. The fields after the placement are optional and
+     * reading stops at the first that doesn't parse, so whatever follows
+     * (EPD operations) is left alone. An en passant square is only kept
+     * when a pawn can take onto it, as make_move does. Returns how many
+     * characters the position took, or -1 and an empty board if the
+     * placement or the dimensions are wrong. */
+    fen_state_init(state, COLOUR_WHITE);
+    clear_board(b);
+    const char* p = parse_placement(b, skip_blanks(fen));
+    if (!p)
+    {
+        clear_board(b);
+        return -1;
+    }
+    state->fields = 1;
+
+    unsigned castling = 0;
+    int en_passant = INDEX_INVALID;
+    const char* end = p;
+    for (p = skip_blanks(p); state->fields < FEN_FIELD_COUNT; p = skip_blanks(end))
+    {
+        switch (state->fields)
         {
-            int idx = r * width + f;
-            piece_t p = b->squares[idx];
-            if (p.type == PIECE_TYPE_EMPTY)
-            {
-                empty_count++;
-            }
-            else
+            case 1:
+                p = parse_turn(p, &state->turn);
+                break;
+            case 2:
+                p = parse_castling(p, &castling);
+                break;
+            case 3:
+                p = parse_en_passant(b, p, state->turn, &en_passant);
+                break;
+            case 4:
+                p = parse_clock(p, &state->halfmove_clock);
+                break;
+            default:
+                p = parse_clock(p, &state->fullmove_number);
+                break;
+        }
+        if (!p)
+            break;
+        end = p;
+        state->fields++;
+    }
+
+    b->castling = (state->fields > 2) ? castling : infer_castling(b);
+    if (en_passant != INDEX_INVALID && can_take_en_passant(b, en_passant, state->turn))
+        b->en_passant = en_passant;
+    b->hash ^= zobrist_castling(b->castling) ^ zobrist_en_passant(b->en_passant);
+    if (state->turn == COLOUR_BLACK)
+        b->hash ^= zobrist_side();
+    return (int)(end - fen);
+}
+
+
+bool fen_dimensions(const char* fen, int* width, int* height)
+{
+    /* the width from the first rank and the height from the rank count,
+     * fen_parse checks the rest agree; files are named a to z */
+    const char* p = skip_blanks(fen);
+    int w = 0;
+    int h = 1;
+    for (; !is_field_end(*p); p++)
+    {
+        if (*p == '/')
+        {
+            h++;
+        }
+        else if (h == 1)
+        {
+            int run = 1;
+            if (*p >= '0' && *p <= '9')
             {
-                if (empty_count)
-                {
-                    pos += snprintf(out_fen + pos, max_len - pos, "%d", empty_count);
-                    empty_count = 0;
-                }
-                char c = piece_to_fen_char(p);
-                out_fen[pos++] = c;
+                p = parse_count(p, &run);
+                if (!p)
+                    return false;
+                p--;
             }
+            w += run;
         }
-        if (empty_count)
+    }
+    if (!w || w > FEN_MAX_FILES)
+        return false;
+    *width = w;
+    *height = h;
+    return true;
+}
+
+
+static char* write_char(char* p, const char* end, char c)
+{
+    /* writers return NULL once the buffer is full, and pass it along */
+    if (!p || p >= end)
+        return NULL;
+    *p++ = c;
+    return p;
+}
+
+
+static char* write_count(char* p, const char* end, int n)
+{
+    if (!p)
+        return NULL;
+    if (n < 10)
+        return write_char(p, end, (char)('0' + n));
+    char digits[FEN_MAX_DIGITS];
+    int count = 0;
+    for (; n; n /= 10)
+        digits[count++] = (char)('0' + n % 10);
+    if (end - p < count)
+        return NULL;
+    while (count)
+        *p++ = digits[--count];
+    return p;
+}
+
+
+static char* write_placement(const board_t* b, char* p, const char* end)
+{
+    const piece_t* square = b->squares;
+    for (int r = 0; r < b->height && p; r++)
+    {
+        int empty = 0;
+        for (int f = 0; f < b->width; f++, square++)
         {
-            pos += snprintf(out_fen + pos, max_len - pos, "%d", empty_count);
+            if (square->type == PIECE_TYPE_EMPTY)
+            {
+                empty++;
+                continue;
+            }
+            if (empty)
+                p = write_count(p, end, empty);
+            empty = 0;
+            p = write_char(p, end, piece_chars[square->colour][square->type]);
         }
-        if (r < height - 1) out_fen[pos++] = '/';
+        if (empty)
+            p = write_count(p, end, empty);
+        if (r < b->height - 1)
+            p = write_char(p, end, '/');
+    }
+    return p;
+}
+
+
+static char* write_turn(char* p, const char* end, colour_t turn)
+{
+    p = write_char(p, end, ' ');
+    return write_char(p, end, turn == COLOUR_BLACK ? 'b' : 'w');
+}
+
+
+static int finish_fen(char* out_fen, char* p, int max_len)
+{
+    /* NUL terminates what fits; returns the length, or -1 if cut short */
+    if (!p)
+    {
+        if (max_len > 0)
+            out_fen[max_len - 1] = '\0';
+        return -1;
+    }
+    *p = '\0';
+    return (int)(p - out_fen);
+}
+
+
+int fen_write(const board_t* b, const fen_state_t* state, char* out_fen, int max_len)
+{
+    /* all six fields, castling and en passant from the board; the end
+     * leaves room for the NUL */
+    if (max_len <= 0)
+        return -1;
+    const char* end = out_fen + max_len - 1;
+    char* p = write_placement(b, out_fen, end);
+    p = write_turn(p, end, state->turn);
+
+    p = write_char(p, end, ' ');
+    if (!b->castling)
+        p = write_char(p, end, '-');
+    for (int i = 0; i < CASTLE_CHAR_COUNT; i++)
+    {
+        if (b->castling & castle_chars[i].bit)
+            p = write_char(p, end, castle_chars[i].c);
+    }
+
+    p = write_char(p, end, ' ');
+    if (b->en_passant == INDEX_INVALID)
+    {
+        p = write_char(p, end, '-');
     }
-    out_fen[pos++] = ' ';
-    out_fen[pos++] = (turn == COLOUR_WHITE) ? 'w' : 'b';
-    out_fen[pos] = '\0';
-    return pos;
+    else
+    {
+        p = write_char(p, end, (char)('a' + b->en_passant % b->width));
+        p = write_count(p, end, b->height - b->en_passant / b->width);
+    }
+
+    p = write_char(p, end, ' ');
+    p = write_count(p, end, state->halfmove_clock);
+    p = write_char(p, end, ' ');
+    p = write_count(p, end, state->fullmove_number);
+    return finish_fen(out_fen, p, max_len);
+}
+
+
+board_t* parse_fen(const char* fen, colour_t* out_turn)
+{
+    /* a new board sized to the fen, NULL if it's malformed */
+    int width = 0;
+    int height = 0;
+    if (!fen_dimensions(fen, &width, &height))
+        return NULL;
+    board_t* b = create_board(width, height);
+    if (!b)
+        return NULL;
+    fen_state_t state;
+    if (fen_parse(b, fen, &state) < 0)
+    {
+        destroy_board(b);
+        return NULL;
+    }
+    *out_turn = state.turn;
+    return b;
+}
+
+
+int generate_fen(const board_t* b, colour_t turn, char* out_fen, int max_len)
+{
+    /* the placement and side to move only */
+    if (max_len <= 0)
+        return -1;
+    const char* end = out_fen + max_len - 1;
+    char* p = write_placement(b, out_fen, end);
+    p = write_turn(p, end, turn);
+    return finish_fen(out_fen, p, max_len);
 }
 
 
@@ -195,10 +491,7 @@ static int promotion_char_to_piece_type(char c)
 
 move_t uci_to_move(const board_t* b, const char* uci)
 {
-    move_t m;
-    m.from = INDEX_INVALID;
-    m.to = INDEX_INVALID;
-    m.promotion = PIECE_TYPE_EMPTY;
+    move_t m = move_encode(INDEX_INVALID, INDEX_INVALID, PIECE_TYPE_EMPTY, MOVE_FLAG_NONE);
 
     if (b == NULL || uci == NULL) return m;
 
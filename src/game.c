@@ -3,34 +3,90 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "arena.h"
 #include "game.h"
 #include "rules.h"
+#include "stats.h"
+#include "util.h"
 #include "movegen.h"
+#include "poscache.h"
+#include "zobrist.h"
 
+#include "movegen/search.h"
 
-static board_t* current_board = NULL;
-static game_config_t config;
-static colour_t current_turn = COLOUR_WHITE;
-static game_status_t current_status = STATUS_ONGOING;
+
+game_t* game_create(const game_config_t* cfg)
+{
+    game_t* game = calloc(1, sizeof(game_t));
+    if (!game)
+        raise_error(ENOMEM, "failed to allocate game"); /* exits here */
+    game_init(game, cfg);
+    return game;
+}
 
 
-void game_init(const game_config_t* cfg)
+void game_destroy(game_t* game)
 {
-    config = *cfg;
-    if (current_board)
+    if (!game)
+        return;
+    if (game->board)
+        destroy_board(game->board);
+    arena_destroy(&game->scratch);
+    poscache_destroy(&game->positions);
+    free(game);
+}
+
+
+void game_init(game_t* game, const game_config_t* cfg)
+{
+    if (cfg->width * cfg->height > MOVE_MAX_SQUARES)
+        raise_error(EINVAL, "board of %dx%d is too large", cfg->width, cfg->height); /* exits here */
+    game->config = *cfg;
+    if (!game->config.random_state)
+        game->config.random_state = random_seed();
+    if (!game->config.search.threads)
+        movegen_search_default_limits(&game->config.search);
+    if (game->board)
     {
-        destroy_board(current_board);
+        destroy_board(game->board);
     }
-    current_board = create_board(cfg->width, cfg->height);
-    current_turn = COLOUR_WHITE;
-    current_status = STATUS_ONGOING;
+    game->board = create_board(cfg->width, cfg->height);
+    if (!arena_reserve(&game->scratch, sizeof(move_list_t) * GAME_SCRATCH_MOVE_LISTS))
+        raise_error(ENOMEM, "failed to allocate game scratch space"); /* exits here */
+    poscache_destroy(&game->positions);
+    if (!poscache_init(&game->positions, cfg->position_cache_entries))
+        raise_error(ENOMEM, "failed to allocate game position cache"); /* exits here */
+    game->turn = COLOUR_WHITE;
+    game->status = STATUS_ONGOING;
+    game->legal_moves.count = 0;
+    game->legal_moves.truncated = false;
+    game->halfmove_clock = 0;
+    game->fullmove_number = 1;
+    game->history_first = 0;
+    game->history_count = 0;
+    memset(game->repetitions, 0, sizeof(game->repetitions));
+}
+
+
+void game_set_seed(game_t* game, uint64_t seed)
+{
+    /* the same seed replays the same choices from the random generators */
+    game->config.random_state = seed ? seed : random_seed();
 }
 
 
-static void realise_game_status(void)
+static game_status_t board_status(game_t* game)
 {
-    bool in_check = is_in_check(current_board, current_turn);
-    bool can_move = has_legal_moves(current_board, current_turn);
+    /* every change of position comes through here, so the move cache is
+     * refreshed along with the status; a position seen before is taken
+     * from the position cache without running the rules */
+    uint64_t key = game->board->hash;
+    int cached_status;
+    if (poscache_lookup(&game->positions, key, &cached_status, &game->legal_moves))
+        return (game_status_t)cached_status;
+    uint64_t start = STATS_TIMER_START();
+    bool in_check = is_in_check(game->board, game->turn);
+    bool can_move = generate_all_moves(game->board, game->turn, &game->legal_moves);
     game_status_t status = STATUS_ONGOING;
     if (in_check)
     {
@@ -40,99 +96,291 @@ static void realise_game_status(void)
     {
         status = STATUS_STALEMATE;
     }
-    current_status = status;
+    poscache_store(&game->positions, key, (int)status, &game->legal_moves);
+    STATS_TIMER_STOP(PHASE_STATUS, start);
+    return status;
+}
+
+
+static void clear_history(game_t* game)
+{
+    /* each entry gives back its own count, which the move that added it
+     * pays for */
+    for (unsigned i = 0; i < game->history_count; i++)
+    {
+        uint64_t hash = game->history[(game->history_first + i) % GAME_HISTORY_SIZE];
+        game->repetitions[hash % GAME_REPETITION_SLOTS]--;
+    }
+    game->history_first = 0;
+    game->history_count = 0;
+}
+
+
+static void record_position(game_t* game)
+{
+    uint64_t hash = game->board->hash;
+    if (game->history_count == GAME_HISTORY_SIZE)
+    {
+        /* only once the fifty move rule has already ended the game */
+        uint64_t oldest = game->history[game->history_first];
+        game->repetitions[oldest % GAME_REPETITION_SLOTS]--;
+        game->history_first = (game->history_first + 1) % GAME_HISTORY_SIZE;
+        game->history_count--;
+    }
+    game->history[(game->history_first + game->history_count) % GAME_HISTORY_SIZE] = hash;
+    game->history_count++;
+    game->repetitions[hash % GAME_REPETITION_SLOTS]++;
+}
+
+
+static bool is_threefold(const game_t* game)
+{
+    /* the history is only searched when the slot says it could be */
+    uint64_t hash = game->board->hash;
+    if (game->repetitions[hash % GAME_REPETITION_SLOTS] < 3)
+        return false;
+    int seen = 0;
+    for (unsigned i = 0; i < game->history_count; i++)
+        seen += game->history[(game->history_first + i) % GAME_HISTORY_SIZE] == hash;
+    return seen >= 3;
+}
+
+
+static void start_history(game_t* game, int halfmove_clock, int fullmove_number)
+{
+    /* a new position, with nothing known about how it was reached */
+    game->halfmove_clock = halfmove_clock;
+    game->fullmove_number = fullmove_number;
+    clear_history(game);
+    record_position(game);
+}
+
+
+static void realise_game_status(game_t* game)
+{
+    /* a mate on the last move stands over either draw rule */
+    game_status_t status = board_status(game);
+    if (status == STATUS_ONGOING || status == STATUS_CHECK)
+    {
+        if (game->halfmove_clock >= GAME_FIFTY_MOVE_PLIES)
+            status = STATUS_FIFTY_MOVES;
+        else if (is_threefold(game))
+            status = STATUS_REPETITION;
+    }
+    game->status = status;
 }
 
 
-void game_set_board(const board_t* b, colour_t turn)
+void game_set_board(game_t* game, const board_t* b, colour_t turn)
 {
-    if (!current_board)
+    if (!game->board)
         return;
-    memcpy(current_board->squares, b->squares, b->width * b->height * sizeof(piece_t));
+    copy_board(game->board, b);
+    game->board->hash = zobrist_hash(game->board, turn);
 
-    current_turn = turn;
-    realise_game_status();
+    game->turn = turn;
+    start_history(game, 0, 1);
+    realise_game_status(game);
 }
 
 
-board_t* game_get_board(void)
+int game_set_fen(game_t* game, const char* fen, fen_state_t* out_state)
 {
-    return current_board;
+    /* parsed straight into the game's board, which must already be the
+     * fen's size; a malformed fen leaves it empty with white to move.
+     * Returns the characters the position took, or -1, and the other
+     * fields in out_state if it isn't NULL */
+    if (!game->board)
+        return -1;
+    fen_state_t state;
+    int len = fen_parse(game->board, fen, &state);
+    if (out_state)
+        *out_state = state;
+    game->turn = state.turn;
+    start_history(game, state.halfmove_clock, state.fullmove_number);
+    realise_game_status(game);
+    return len;
 }
 
 
-bool game_get_best_move(move_t* m)
+int game_get_fen(const game_t* game, char* out_fen, int max_len)
 {
-    m->from = 0;
-    m->to = 0;
-    m->promotion = PIECE_TYPE_EMPTY;
-    return movegen_get_move(&config, current_board, current_turn, m, current_status);
+    /* all six fields, or -1 if they don't fit */
+    fen_state_t state;
+    fen_state_init(&state, game->turn);
+    state.halfmove_clock = game->halfmove_clock;
+    state.fullmove_number = game->fullmove_number;
+    return fen_write(game->board, &state, out_fen, max_len);
 }
 
 
-bool game_apply_move(move_t* m)
+board_t* game_get_board(game_t* game)
 {
-    piece_t* p = get_piece(current_board, m->from);
+    return game->board;
+}
+
+
+arena_t* game_get_scratch(game_t* game)
+{
+    /* move lists for a single request, callers release back to their mark */
+    return &game->scratch;
+}
+
+
+uint64_t game_get_hash(const game_t* game)
+{
+    return game->board->hash;
+}
+
+
+void game_get_history(const game_t* game, game_history_t* history)
+{
+    /* the ring laid out flat */
+    for (unsigned i = 0; i < game->history_count; i++)
+        history->hashes[i] = game->history[(game->history_first + i) % GAME_HISTORY_SIZE];
+    history->count = game->history_count;
+    history->halfmove_clock = game->halfmove_clock;
+}
+
+
+bool game_get_best_move(game_t* game, move_t* m)
+{
+    /* a cached best move is only good for a position with no history
+     * behind it, elsewhere the way back to an earlier one can change it,
+     * and only kept when asking again would give the same move */
+    *m = move_encode(0, 0, PIECE_TYPE_EMPTY, MOVE_FLAG_NONE);
+    uint64_t key = game->board->hash;
+    bool cacheable = game->history_count <= 1;
+    if (cacheable && poscache_best_move(&game->positions, key, m))
+        return true;
+    unsigned epoch = poscache_epoch();
+    game_history_t history;
+    game_get_history(game, &history);
+    uint64_t start = STATS_TIMER_START();
+    bool repeatable = false;
+    bool found = movegen_get_move(&game->config, game->board, game->turn, &game->legal_moves, &game->scratch, m, game->status, &history, &repeatable);
+    STATS_TIMER_STOP(PHASE_BEST_MOVE, start);
+    if (!found)
+        return false;
+    if (cacheable && repeatable)
+        poscache_store_best_move(&game->positions, key, m, epoch);
+    return true;
+}
+
+
+static bool find_legal_move(const game_t* game, move_t* m)
+{
+    /* swaps in the cached move so it carries the generator's flags; one
+     * past the end of a full list is looked for on its own square */
+    for (int i = 0; i < game->legal_moves.count; i++)
+    {
+        if (move_equal(&game->legal_moves.moves[i], m))
+        {
+            *m = game->legal_moves.moves[i];
+            return true;
+        }
+    }
+    return game->legal_moves.truncated && resolve_move(game->board, m);
+}
+
+
+bool game_apply_move(game_t* game, move_t* m)
+{
+    int size = game->board->width * game->board->height;
+    if (m->from < 0 || m->from >= size || m->to < 0 || m->to >= size)
+    {
+        printf("move off the board\n");
+        return false;
+    }
+    piece_t* p = get_piece(game->board, m->from);
     if (p->type == PIECE_TYPE_EMPTY)
     {
         printf("couldn't get piece\n");
         return false;
     }
-    if (STATUS_CHECKMATE == current_status
-        || STATUS_STALEMATE == current_status)
+    if (STATUS_ONGOING != game->status
+        && STATUS_CHECK != game->status)
     {
         printf("end of game\n");
         return false;
     }
-    if (p->colour != current_turn)
+    if (p->colour != game->turn)
     {
         printf("not right colour's turn\n");
         return false;
     }
-    if (!is_move_legal(current_board, m))
+    if (!find_legal_move(game, m))
     {
         printf("illegal move\n");
         return false;
     }
-    if (STATUS_CHECK == current_status
-        && !would_move_release_check(current_board, m))
+    uint64_t start = STATS_TIMER_START();
+    undo_t undo;
+    make_move(game->board, m, &undo);
+    if (undo.moved.type == PIECE_TYPE_PAWN || undo.captured.type != PIECE_TYPE_EMPTY)
     {
-        printf("need to release check\n");
-        return false;
-    }
-    if (PIECE_TYPE_EMPTY != m->promotion)
-    {
-        piece_t new_p;
-        new_p.colour = p->colour;
-        new_p.type = m->promotion;
-        set_piece(current_board, m->to, &new_p);
+        game->halfmove_clock = 0;
+        clear_history(game);
     }
     else
     {
-        set_piece(current_board, m->to, p);
+        game->halfmove_clock++;
     }
-    piece_t empty = { PIECE_TYPE_EMPTY, COLOUR_NONE };
-    set_piece(current_board, m->from, &empty);
+    if (game->turn == COLOUR_BLACK)
+        game->fullmove_number++;
 
-    current_turn = (current_turn == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
-    realise_game_status();
+    game->turn = (game->turn == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+    record_position(game);
+    realise_game_status(game);
+    STATS_TIMER_STOP(PHASE_APPLY_MOVE, start);
     return true;
 }
 
 
-int game_get_available_moves(unsigned index, move_t* moves, unsigned max_moves)
+int game_get_available_moves(game_t* game, unsigned index, move_t* moves, unsigned max_moves)
+{
+    if (index >= (unsigned)(game->board->width * game->board->height))
+        return 0;
+    if (get_piece(game->board, index)->colour != game->turn || game->legal_moves.truncated)
+        return generate_moves(game->board, index, moves, max_moves);
+    unsigned count = 0;
+    for (int i = 0; i < game->legal_moves.count && count < max_moves; i++)
+    {
+        if (game->legal_moves.moves[i].from == (int)index)
+            moves[count++] = game->legal_moves.moves[i];
+    }
+    return count;
+}
+
+
+const move_list_t* game_get_legal_moves(const game_t* game)
+{
+    return &game->legal_moves;
+}
+
+
+game_status_t game_get_status(const game_t* game)
+{
+    return game->status;
+}
+
+
+colour_t game_current_turn(const game_t* game)
 {
-    return generate_moves(current_board, index, STATUS_CHECK == current_status, moves, max_moves);
+    return game->turn;
 }
 
 
-game_status_t game_get_status(void)
+bool game_set_position_cache_size(game_t* game, unsigned entries)
 {
-    return current_status;
+    /* starts the cache afresh, 0 turns it off */
+    game->config.position_cache_entries = entries;
+    poscache_destroy(&game->positions);
+    return poscache_init(&game->positions, entries);
 }
 
 
-colour_t game_current_turn(void)
+void game_get_position_cache_stats(const game_t* game, poscache_stats_t* stats)
 {
-    return current_turn;
+    poscache_get_stats(&game->positions, stats);
 }
@@ -8,36 +8,102 @@
 #define EMSCRIPTEN_KEEPALIVE
 #endif
 
+#include "arena.h"
+#include "batch.h"
+#include "book.h"
 #include "game.h"
 #include "fen.h"
 #include "movegen.h"
+#include "movegen/search.h"
+#include "perft.h"
+#include "poscache.h"
+#include "rules.h"
+#include "stats.h"
+#include "tb.h"
+#include "tt.h"
+#include "zobrist.h"
+
+
+#define LEGAL_MOVE_BYTES        3
+#define LEGAL_MOVE_MAX_SQUARES  256
+
+
+/* The exports without a game argument act on a default game, set up by
+ * init_game, which is what the page uses. Anything that wants several games
+ * at once creates handles with create_game and passes them to the *_game_*
+ * exports. */
+static game_t* default_game = NULL;
+/* its search limits, kept when init_game starts it again; 0 threads until
+ * they are first set */
+static search_limits_t default_search;
+
+
+/* games remember the best move given for each position they've visited,
+ * anything that could change the answer makes those stale */
+static void settings_changed(void)
+{
+    poscache_forget_best_moves();
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+game_t* create_game(int width, int height)
+{
+    game_config_t cfg = {width, height, true, true, true, POSCACHE_DEFAULT_ENTRIES};
+    game_t* game = game_create(&cfg);
+    printf("created game %p\n", (void*)game);
+    return game;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void destroy_game(game_t* game)
+{
+    printf("destroying game %p\n", (void*)game);
+    if (game == default_game)
+        default_game = NULL;
+    game_destroy(game);
+}
 
 
 EMSCRIPTEN_KEEPALIVE
 void init_game(int width, int height)
 {
     printf("initialising game\n");
-    game_config_t cfg = {width, height, true, true, true};
-    game_init(&cfg);
+    game_config_t cfg = {width, height, true, true, true, POSCACHE_DEFAULT_ENTRIES};
+    cfg.search = default_search;
+    if (default_game)
+        game_init(default_game, &cfg);
+    else
+        default_game = game_create(&cfg);
 }
 
 
 EMSCRIPTEN_KEEPALIVE
-void set_fen(const char* fen)
+bool set_game_fen(game_t* game, const char* fen)
 {
     printf("setting fen: '%s'\n", fen);
-    colour_t turn = COLOUR_NONE;
-    board_t* b = parse_fen(fen, &turn);
-    game_set_board(b, turn);
-    destroy_board(b);
+    if (game_set_fen(game, fen, NULL) < 0)
+    {
+        printf("invalid fen for a %dx%d board\n", game->config.width, game->config.height);
+        return false;
+    }
+    return true;
 }
 
 
 EMSCRIPTEN_KEEPALIVE
-int get_fen(char* out_fen, int max_len)
+bool set_fen(const char* fen)
+{
+    return set_game_fen(default_game, fen);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_fen(game_t* game, char* out_fen, int max_len)
 {
-    board_t* b = game_get_board();
-    colour_t turn = game_current_turn();
+    board_t* b = game_get_board(game);
+    colour_t turn = game_current_turn(game);
     int len = generate_fen(b, turn, out_fen, max_len);
     printf("getting fen: '%.*s'\n", max_len, out_fen);
     return len;
@@ -45,11 +111,160 @@ int get_fen(char* out_fen, int max_len)
 
 
 EMSCRIPTEN_KEEPALIVE
-int get_best_move(char* out_uci, int max_len)
+int get_fen(char* out_fen, int max_len)
+{
+    return get_game_fen(default_game, out_fen, max_len);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_full_fen(game_t* game, char* out_fen, int max_len)
+{
+    /* with castling, en passant and the clocks, which get_fen leaves out */
+    int len = game_get_fen(game, out_fen, max_len);
+    printf("getting full fen: '%.*s'\n", max_len, out_fen);
+    return len;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_full_fen(char* out_fen, int max_len)
+{
+    return get_game_full_fen(default_game, out_fen, max_len);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_position_hash(game_t* game, char* out_hex, int max_len)
+{
+    int len = snprintf(out_hex, max_len, "%016llx", (unsigned long long)game_get_hash(game));
+    printf("getting position hash: %.*s\n", max_len, out_hex);
+    return len;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_position_hash(char* out_hex, int max_len)
+{
+    return get_game_position_hash(default_game, out_hex, max_len);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_piece_mask(game_t* game, int colour, int type, char* out_hex, int max_len)
+{
+    /* occupancy mask of one colour's pieces of a type, or of all of them for
+     * PIECE_TYPE_EMPTY, in hex like the hash; 0 if the board keeps none */
+    board_t* b = game_get_board(game);
+    if (!b->has_bitboards || colour <= COLOUR_NONE || colour >= COLOUR_COUNT
+        || type < PIECE_TYPE_EMPTY || type >= PIECE_TYPE_COUNT)
+    {
+        return 0;
+    }
+    bitboard_t mask = (type == PIECE_TYPE_EMPTY) ? b->occupied[colour] : b->pieces[colour][type];
+    int len = snprintf(out_hex, max_len, "%016llx", (unsigned long long)mask);
+    printf("getting piece mask: %.*s\n", max_len, out_hex);
+    return len;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_piece_mask(int colour, int type, char* out_hex, int max_len)
+{
+    return get_game_piece_mask(default_game, colour, type, out_hex, max_len);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_square_attackers(game_t* game, int index, int colour)
+{
+    /* how many of colour's pieces attack a square, indexed from a8 like the
+     * packed moves; -1 for a square off the board */
+    board_t* b = game_get_board(game);
+    if (index < 0 || index >= b->width * b->height
+        || colour <= COLOUR_NONE || colour >= COLOUR_COUNT)
+    {
+        return -1;
+    }
+    int count = count_attackers(b, index, colour);
+    /* both lookups, so a caller sees if they ever disagree */
+    if ((count > 0) != is_square_attacked(b, index, colour))
+        return -1;
+    return count;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_square_attackers(int index, int colour)
+{
+    return get_game_square_attackers(default_game, index, colour);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int check_game_make_unmake(game_t* game)
+{
+    /* makes and takes back each legal move of the side to move; once made,
+     * the masks and hash must match ones rebuilt from the squares, and once
+     * taken back the board must be as it was. Returns the moves checked, or
+     * -1 at the first that fails */
+    board_t* b = game_get_board(game);
+    colour_t next = (game_current_turn(game) == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+    board_t* before = duplicate_board(b);
+    board_t* rebuilt = duplicate_board(b);
+    const move_list_t* list = game_get_legal_moves(game);
+    int checked = 0;
+    for (int i = 0; i < list->count && checked >= 0; i++)
+    {
+        undo_t undo;
+        make_move(b, &list->moves[i], &undo);
+        copy_board(rebuilt, b);
+        sync_bitboards(rebuilt);
+        rebuilt->hash = zobrist_hash(rebuilt, next);
+        bool made = boards_equal(b, rebuilt);
+        unmake_move(b, &undo);
+        checked = (made && boards_equal(b, before)) ? checked + 1 : -1;
+    }
+    destroy_board(rebuilt);
+    destroy_board(before);
+    printf("made and took back %d moves\n", checked);
+    return checked;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int check_make_unmake(void)
+{
+    return check_game_make_unmake(default_game);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+double get_game_perft(game_t* game, int depth)
+{
+    /* a double keeps the count exact well past any depth worth running and
+     * avoids 64-bit return values in the wasm bindings */
+    printf("running perft to depth %d\n", depth);
+    uint64_t start = STATS_TIMER_START();
+    uint64_t nodes = perft(game_get_board(game), game_current_turn(game), depth);
+    STATS_TIMER_STOP(PHASE_PERFT, start);
+    return (double)nodes;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+double get_perft(int depth)
 {
-    board_t* b = game_get_board();
+    return get_game_perft(default_game, depth);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_best_move(game_t* game, char* out_uci, int max_len)
+{
+    board_t* b = game_get_board(game);
     move_t m;
-    if (!game_get_best_move(&m))
+    if (!game_get_best_move(game, &m))
     {
         printf("failed to get best move\n");
         return 0;
@@ -60,6 +275,13 @@ int get_best_move(char* out_uci, int max_len)
 }
 
 
+EMSCRIPTEN_KEEPALIVE
+int get_best_move(char* out_uci, int max_len)
+{
+    return get_game_best_move(default_game, out_uci, max_len);
+}
+
+
 EMSCRIPTEN_KEEPALIVE
 int get_movegen_list(char* buffer, unsigned list_len, unsigned row_len)
 {
@@ -84,10 +306,27 @@ EMSCRIPTEN_KEEPALIVE
 bool set_movegen(const char* name)
 {
     printf("setting movegen name: %s\n", name);
+    settings_changed();
     return movegen_set(name);
 }
 
 
+EMSCRIPTEN_KEEPALIVE
+void set_game_seed(game_t* game, unsigned seed)
+{
+    /* 0 picks a new seed from the clock */
+    printf("setting random seed: %u\n", seed);
+    game_set_seed(game, seed);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void set_seed(unsigned seed)
+{
+    set_game_seed(default_game, seed);
+}
+
+
 EMSCRIPTEN_KEEPALIVE
 const char* get_movegen_name(void)
 {
@@ -98,20 +337,283 @@ const char* get_movegen_name(void)
 
 
 EMSCRIPTEN_KEEPALIVE
-int get_status(void)
+void set_game_search_limits(game_t* game, int max_depth, int max_time_ms, int max_nodes)
+{
+    printf("setting search limits: depth %d, %d ms, %d nodes\n", max_depth, max_time_ms, max_nodes);
+    movegen_search_set_limits(&game->config.search, max_depth, max_time_ms, max_nodes);
+    settings_changed();
+}
+
+
+static search_limits_t* default_search_limits(void)
+{
+    if (!default_search.threads)
+        movegen_search_default_limits(&default_search);
+    return &default_search;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void set_search_limits(int max_depth, int max_time_ms, int max_nodes)
+{
+    movegen_search_set_limits(default_search_limits(), max_depth, max_time_ms, max_nodes);
+    if (default_game)
+        set_game_search_limits(default_game, max_depth, max_time_ms, max_nodes);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void set_game_search_threads(game_t* game, int threads)
+{
+    printf("setting search threads: %d\n", threads);
+    movegen_search_set_threads(&game->config.search, threads);
+    settings_changed();
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void set_search_threads(int threads)
+{
+    movegen_search_set_threads(default_search_limits(), threads);
+    if (default_game)
+        set_game_search_threads(default_game, threads);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void stop_search(void)
+{
+    printf("stopping search\n");
+    /* the cut short search's move isn't kept for next time */
+    settings_changed();
+    movegen_search_stop();
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+bool set_hash_size(unsigned size_mb)
+{
+    printf("setting hash size: %u MB\n", size_mb);
+    return tt_resize(size_mb);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_hash_stats(double* out_stats, int max_len)
+{
+    /* size in MB, entries, used, hits, misses, stores */
+    tt_stats_t stats;
+    tt_get_stats(&stats);
+    double values[] = {
+        stats.size_mb, (double)stats.entries, (double)stats.used,
+        (double)stats.hits, (double)stats.misses, (double)stats.stores
+    };
+    int count = sizeof(values) / sizeof(values[0]);
+    if (max_len < count)
+        count = max_len;
+    memcpy(out_stats, values, sizeof(double) * (count > 0 ? count : 0));
+    return count;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+bool set_game_position_cache_size(game_t* game, unsigned entries)
+{
+    printf("setting position cache size: %u entries\n", entries);
+    return game_set_position_cache_size(game, entries);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+bool set_position_cache_size(unsigned entries)
+{
+    return set_game_position_cache_size(default_game, entries);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_position_cache_stats(game_t* game, double* out_stats, int max_len)
+{
+    /* capacity, used, hits, misses, best move hits, evictions */
+    poscache_stats_t stats;
+    game_get_position_cache_stats(game, &stats);
+    double values[] = {
+        stats.capacity, stats.used, (double)stats.hits, (double)stats.misses,
+        (double)stats.best_move_hits, (double)stats.evictions
+    };
+    int count = sizeof(values) / sizeof(values[0]);
+    if (max_len < count)
+        count = max_len;
+    memcpy(out_stats, values, sizeof(double) * (count > 0 ? count : 0));
+    return count;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_position_cache_stats(double* out_stats, int max_len)
+{
+    return get_game_position_cache_stats(default_game, out_stats, max_len);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_engine_stats(char* out_json, int max_len)
+{
+    /* the profiling counters as JSON, all zero unless built with
+     * ENGINE_STATS; -1 if max_len is too short */
+    return stats_to_json(out_json, max_len);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void reset_engine_stats(void)
+{
+    printf("resetting engine stats\n");
+    stats_reset();
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+bool open_book(const char* path)
+{
+    printf("opening book: '%s'\n", path);
+    settings_changed();
+    return book_open(path);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+bool load_book(unsigned char* data, int size)
+{
+    /* data comes from _malloc and belongs to the book from here on */
+    printf("loading book: %d bytes\n", size);
+    settings_changed();
+    if (size <= 0)
+    {
+        free(data);
+        return false;
+    }
+    return book_adopt(data, (size_t)size);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void close_book(void)
+{
+    printf("closing book\n");
+    settings_changed();
+    book_close();
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_book_entries(void)
+{
+    return (int)book_entry_count();
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int open_tablebases(const char* dir)
+{
+    settings_changed();
+    int count = tb_open(dir);
+    printf("opened %d endgame tables from '%s'\n", count, dir);
+    return count;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+bool load_tablebase(unsigned char* data, int size)
+{
+    /* data comes from _malloc and belongs to the tables from here on */
+    printf("loading endgame table: %d bytes\n", size);
+    settings_changed();
+    if (size <= 0)
+    {
+        free(data);
+        return false;
+    }
+    return tb_adopt(data, (size_t)size);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+void close_tablebases(void)
+{
+    printf("closing endgame tables\n");
+    settings_changed();
+    tb_close();
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int probe_game_tablebase(game_t* game, int* out_dtm)
+{
+    /* draw 0, win 1, loss 2 for the side to move, -1 if not covered */
+    tb_result_t result;
+    if (!tb_probe(game_get_board(game), game_current_turn(game), &result))
+        return -1;
+    *out_dtm = result.dtm;
+    printf("endgame table: %d in %d\n", (int)result.wdl, result.dtm);
+    return (int)result.wdl;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int probe_tablebase(int* out_dtm)
+{
+    return probe_game_tablebase(default_game, out_dtm);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int analyse_epd(const char* in_path, const char* out_path, int threads)
+{
+    /* a whole file in one call, returns the positions analysed or -1 */
+    FILE* in = fopen(in_path, "r");
+    if (!in)
+        return -1;
+    FILE* out = fopen(out_path, "w");
+    if (!out)
+    {
+        fclose(in);
+        return -1;
+    }
+    /* searched within the default game's limits */
+    batch_stats_t stats = {0};
+    bool ok = batch_analyse(in, out, threads, default_search_limits(), &stats);
+    fclose(in);
+    if (fclose(out))
+        ok = false;
+    printf("analysed %ld positions (%ld invalid) from '%s' in %.3fs\n",
+        stats.positions, stats.invalid, in_path, (double)stats.elapsed_us / 1000000.0);
+    return ok ? (int)stats.positions : -1;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_status(game_t* game)
 {
     printf("getting status\n");
-    return (int)game_get_status();
+    return (int)game_get_status(game);
 }
 
 
 EMSCRIPTEN_KEEPALIVE
-bool apply_move_uci(const char* uci)
+int get_status(void)
+{
+    return get_game_status(default_game);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+bool apply_game_move_uci(game_t* game, const char* uci)
 {
     printf("move uci: '%s'\n", uci);
-    board_t* b = game_get_board();
+    board_t* b = game_get_board(game);
     move_t m = uci_to_move(b, uci);
-    if (!game_apply_move(&m))
+    if (!game_apply_move(game, &m))
     {
         return false;
     }
@@ -120,15 +622,24 @@ bool apply_move_uci(const char* uci)
 
 
 EMSCRIPTEN_KEEPALIVE
-int get_available_moves_uci(const char* pos, char* buf, unsigned buflen)
+bool apply_move_uci(const char* uci)
 {
-    board_t* b = game_get_board();
+    return apply_game_move_uci(default_game, uci);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_available_moves_uci(game_t* game, const char* pos, char* buf, unsigned buflen)
+{
+    board_t* b = game_get_board(game);
     int index = pos_to_index(b, pos);
-    unsigned max_moves = b->height * b->width;
-    move_t* moves = malloc(sizeof(move_t) * max_moves);
+    arena_t* scratch = game_get_scratch(game);
+    size_t mark = arena_mark(scratch);
+    unsigned max_moves = max_piece_moves(b);
+    move_t* moves = arena_alloc(scratch, sizeof(move_t) * max_moves);
     if (!moves)
         return -1;
-    int move_count = game_get_available_moves(index, moves, max_moves);
+    int move_count = game_get_available_moves(game, index, moves, max_moves);
     char* p = buf;
     int len = 0;
     for (int i = 0; i < move_count; i++)
@@ -142,8 +653,47 @@ int get_available_moves_uci(const char* pos, char* buf, unsigned buflen)
         buf[len++] = ',';
         p = buf + len;
     }
-    buf[--len] = '\0';
-    free(moves);
+    if (len)
+        len--;
+    buf[len] = '\0';
+    arena_release(scratch, mark);
     printf("available moves for pos '%s': %.*s\n", pos, len, buf);
     return len;
 }
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_available_moves_uci(const char* pos, char* buf, unsigned buflen)
+{
+    return get_game_available_moves_uci(default_game, pos, buf, buflen);
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_game_legal_moves_packed(game_t* game, unsigned char* out, int max_moves)
+{
+    /* three bytes per move for the side to move: from, to, promotion piece
+     * type, with squares indexed from a8; -1 if squares don't fit a byte
+     * or there are more moves than the list holds */
+    board_t* b = game_get_board(game);
+    const move_list_t* list = game_get_legal_moves(game);
+    if (b->width * b->height > LEGAL_MOVE_MAX_SQUARES || list->truncated)
+        return -1;
+    int count = (list->count < max_moves) ? list->count : max_moves;
+    for (int i = 0; i < count; i++)
+    {
+        const move_t* m = &list->moves[i];
+        out[i * LEGAL_MOVE_BYTES] = m->from;
+        out[i * LEGAL_MOVE_BYTES + 1] = m->to;
+        out[i * LEGAL_MOVE_BYTES + 2] = m->promotion;
+    }
+    printf("packed %d legal moves\n", count);
+    return count;
+}
+
+
+EMSCRIPTEN_KEEPALIVE
+int get_legal_moves_packed(unsigned char* out, int max_moves)
+{
+    return get_game_legal_moves_packed(default_game, out, max_moves);
+}
@@ -3,27 +3,55 @@
 
 #include "movegen.h"
 #include "board.h"
+#include "book.h"
 #include "move.h"
 #include "game.h"
+#include "stats.h"
+#include "tb.h"
 
 #include "movegen/random.h"
 #include "movegen/fav_colour.h"
+#include "movegen/search.h"
 
 
-#define MOVEGEN(_name)          { # _name , movegen_ ## _name ## _generator }
+#define MOVEGEN(_name, _deterministic)  { # _name , _deterministic, movegen_ ## _name ## _generator }
 
 
 static const movegen_t move_generators[] =
 {
-    MOVEGEN(random),
-    MOVEGEN(fav_colour),
+    MOVEGEN(random, false),
+    MOVEGEN(fav_colour, false),
+    MOVEGEN(search, true),
 };
 static const movegen_t* move_generator = &move_generators[0];
 
 
-bool movegen_get_move(game_config_t* config, board_t* board, colour_t turn, move_t* move, game_status_t status)
+bool movegen_get_move(game_config_t* config, board_t* board, colour_t turn, const move_list_t* legal_moves, arena_t* scratch, move_t* move, game_status_t status, const game_history_t* history, bool* repeatable)
 {
-    return move_generator->generator(config, board, turn, move, status);
+    /* known positions are answered from the book or the endgame tables
+     * without running the generator; repeatable says whether asking again
+     * would give the same move, book moves being picked at random */
+    uint64_t start = STATS_TIMER_START();
+    bool found = book_probe(board->hash, legal_moves, &config->random_state, move);
+    STATS_TIMER_STOP(PHASE_BOOK, start);
+    if (found)
+    {
+        *repeatable = false;
+        return true;
+    }
+    start = STATS_TIMER_START();
+    found = tb_best_move(board, turn, legal_moves, move);
+    STATS_TIMER_STOP(PHASE_TABLEBASE, start);
+    if (found)
+    {
+        *repeatable = true;
+        return true;
+    }
+    start = STATS_TIMER_START();
+    found = move_generator->generator(config, board, turn, legal_moves, scratch, move, status, history);
+    STATS_TIMER_STOP(PHASE_GENERATOR, start);
+    *repeatable = move_generator->deterministic;
+    return found;
 }
 
 
@@ -42,18 +70,27 @@ int movegen_list(char** list, unsigned list_len, unsigned row_len)
 }
 
 
-bool movegen_set(const char* name)
+const movegen_t* movegen_find(const char* name)
 {
     unsigned len = sizeof(move_generators) / sizeof(move_generators[0]);
     for (unsigned i = 0; i < len; i++)
     {
         if (0 == strcmp(name, move_generators[i].name))
         {
-            move_generator = &move_generators[i];
-            return true;
+            return &move_generators[i];
         }
     }
-    return false;
+    return NULL;
+}
+
+
+bool movegen_set(const char* name)
+{
+    const movegen_t* found = movegen_find(name);
+    if (!found)
+        return false;
+    move_generator = found;
+    return true;
 }
 
 
@@ -1,13 +1,14 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 
+#include "arena.h"
 #include "board.h"
 #include "move.h"
 #include "game.h"
 #include "rules.h"
 #include "fen.h"
+#include "stats.h"
 #include "util.h"
 
 
@@ -22,48 +23,25 @@ static bool tile_is_white(unsigned index, unsigned width)
 static unsigned can_be_taken(board_t* board, colour_t turn, unsigned index)
 {
     /* will return number of pieces that can take it */
-    unsigned count = 0;
-    for (unsigned i = 0; i < board->width * board->height; i++)
-    {
-        if (i == index)
-            continue;
-        piece_t* p = get_piece(board, i);
-        if (turn == p->colour)
-            continue;
-        move_t m =
-        {
-            .from = i,
-            .to = index,
-            .promotion = PIECE_TYPE_EMPTY,
-        };
-        if (is_move_legal(board, &m))
-            count++;
-    }
-    return count;
+    colour_t enemy = (COLOUR_WHITE == turn) ? COLOUR_BLACK : COLOUR_WHITE;
+    return count_attackers(board, index, enemy);
 }
 
 
-static unsigned can_move_be_taken(board_t* board, board_t* consider_board, colour_t turn, move_t* move)
+static unsigned can_move_be_taken(board_t* board, colour_t turn, move_t* move)
 {
-    if (!copy_board(consider_board, board))
-    {
-        raise_error(ENOMEM, "failed to copy board\n"); /* exits here */
-        return 0;
-    }
-
     /* assume given move IS legal */
-
-    piece_t* p = get_piece(consider_board, move->from);
-    set_piece(consider_board, move->to, p);
-    piece_t empty = { PIECE_TYPE_EMPTY, COLOUR_NONE };
-    set_piece(consider_board, move->from, &empty);
-
-    return can_be_taken(consider_board, turn, move->to);
+    undo_t undo;
+    make_move(board, move, &undo);
+    unsigned count = can_be_taken(board, turn, move->to);
+    unmake_move(board, &undo);
+    return count;
 }
 
 
-static double gen_move_value(board_t* board, board_t* consider_board, colour_t turn, move_t* move)
+static double gen_move_value(board_t* board, colour_t turn, move_t* move)
 {
+    STATS_COUNT(STAT_MOVES_SCORED);
     double value = 0.;
     piece_t* p = get_piece(board, move->from);
 
@@ -73,7 +51,7 @@ static double gen_move_value(board_t* board, board_t* consider_board, colour_t t
         && (COLOUR_WHITE == turn) == from_white)
     {
         /* is a bishop on the wrong colour square */
-        value = 10000. * (double)can_move_be_taken(board, consider_board, turn, move);
+        value = 10000. * (double)can_move_be_taken(board, turn, move);
         return value;
     }
 
@@ -90,20 +68,19 @@ static double gen_move_value(board_t* board, board_t* consider_board, colour_t t
 }
 
 
-static move_t* select_move(board_t* board, colour_t turn, move_t* moves, unsigned num_moves)
+static const move_t* select_move(arena_t* scratch, uint64_t* random_state, board_t* board, colour_t turn, const move_t* moves, unsigned num_moves)
 {
-    srand(time(NULL));
-
-    unsigned* fav_moves_index = malloc(sizeof(unsigned) * num_moves);
+    unsigned* fav_moves_index = arena_alloc(scratch, sizeof(unsigned) * num_moves);
+    if (!fav_moves_index)
+        return NULL;
     unsigned num_fav_moves = 0;
 
     double fav_move_value = 0.;
-    board_t* consider_board = duplicate_board(board);
 
     for (unsigned i = 0; i < num_moves; i++)
     {
-        move_t* consider_move = &moves[i];
-        double new_value = gen_move_value(board, consider_board, turn, consider_move);
+        move_t consider_move = moves[i];
+        double new_value = gen_move_value(board, turn, &consider_move);
         if (!num_fav_moves)
         {
             fav_moves_index[num_fav_moves++] = i;
@@ -120,7 +97,6 @@ static move_t* select_move(board_t* board, colour_t turn, move_t* moves, unsigne
             fav_moves_index[num_fav_moves++] = i;
         }
     }
-    destroy_board(consider_board);
 
     if (!num_fav_moves)
     {
@@ -132,34 +108,22 @@ static move_t* select_move(board_t* board, colour_t turn, move_t* moves, unsigne
     unsigned index_index = 0;
     if (num_fav_moves > 1)
     {
-        index_index = rand() % num_fav_moves;
+        index_index = random_next(random_state) % num_fav_moves;
     }
     unsigned index = fav_moves_index[index_index];
-    move_t* move = &moves[index];
-    free(fav_moves_index);
-
-    return move;
+    return &moves[index];
 }
 
 
-bool movegen_fav_colour_generator(game_config_t* config, board_t* board, colour_t turn, move_t* move, game_status_t status)
+bool movegen_fav_colour_generator(game_config_t* config, board_t* board, colour_t turn, const move_list_t* legal_moves, arena_t* scratch, move_t* move, game_status_t status, const game_history_t* history)
 {
-    unsigned max_legal_moves = config->height * config->width * 32;
-    move_t* legal_moves = malloc(sizeof(move_t) * max_legal_moves);
-    int legal_count = 0;
-    if (!generate_all_moves(board, turn, STATUS_CHECK == status, legal_moves, max_legal_moves, &legal_count))
-    {
-        return false;
-    }
-
-    if (legal_count == 0)
-        return false;
-
-    move_t* move_l_ptr = select_move(board, turn, legal_moves, legal_count);
-    if (!move_l_ptr)
-        return false;
-
-    memcpy(move, move_l_ptr, sizeof(move_t));
-    free(legal_moves);
-    return true;
+    size_t mark = arena_mark(scratch);
+    const move_t* move_l_ptr = NULL;
+    if (legal_moves->count > 0)
+        move_l_ptr = select_move(scratch, &config->random_state, board, turn, legal_moves->moves, legal_moves->count);
+
+    if (move_l_ptr)
+        *move = *move_l_ptr;
+    arena_release(scratch, mark);
+    return move_l_ptr != NULL;
 }
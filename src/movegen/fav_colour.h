@@ -7,4 +7,4 @@
 #include "game.h"
 
 
-bool movegen_fav_colour_generator(game_config_t* config, board_t* board, colour_t turn, move_t* move, game_status_t status);
+bool movegen_fav_colour_generator(game_config_t* config, board_t* board, colour_t turn, const move_list_t* legal_moves, arena_t* scratch, move_t* move, game_status_t status, const game_history_t* history);
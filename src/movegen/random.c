@@ -1,30 +1,17 @@
 #include <stdbool.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
 
 #include "board.h"
 #include "move.h"
 #include "game.h"
-#include "rules.h"
+#include "util.h"
 
 
-bool movegen_random_generator(game_config_t* config, board_t* board, colour_t turn, move_t* move, game_status_t status)
+bool movegen_random_generator(game_config_t* config, board_t* board, colour_t turn, const move_list_t* legal_moves, arena_t* scratch, move_t* move, game_status_t status, const game_history_t* history)
 {
-    unsigned max_legal_moves = config->height * config->width * 10;
-    move_t* legal_moves = malloc(sizeof(move_t) * max_legal_moves);
-    int legal_count = 0;
-    if (!generate_all_moves(board, turn, STATUS_CHECK == status, legal_moves, max_legal_moves, &legal_count))
-    {
+    if (legal_moves->count == 0)
         return false;
-    }
 
-    if (legal_count == 0)
-        return false;
-
-    srand(time(NULL));
-    int random_index = rand() % legal_count;
-    memcpy(move, &legal_moves[random_index], sizeof(move_t));
-    free(legal_moves);
+    int random_index = random_next(&config->random_state) % legal_moves->count;
+    *move = legal_moves->moves[random_index];
     return true;
 }
@@ -0,0 +1,616 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "move.h"
+#include "game.h"
+#include "rules.h"
+#include "stats.h"
+#include "tt.h"
+#include "util.h"
+
+#include "search.h"
+
+
+#define SEARCH_MAX_PLY          64
+#define SEARCH_INFINITY         32000
+#define SEARCH_MATE             30000
+#define SEARCH_CHECK_INTERVAL   1024    /* nodes between budget checks */
+#define SEARCH_THREAD_STACK     (1024 * 1024)
+
+
+typedef struct
+{
+    board_t* board;
+    undo_stack_t undo;
+    search_limits_t limits;     /* the game's, as they were when it began */
+    uint64_t deadline_us;
+    long nodes;
+    bool stopped;
+    bool helper;            /* helpers stop with the main search, not on nodes */
+    unsigned stop_epoch;    /* stop_search calls made before this search began */
+    atomic_bool* helpers_stop;  /* this search's own, set when its main thread is done */
+    const game_history_t* history;  /* how the game reached the root, or NULL */
+    int depth_offset;
+    move_t killers[SEARCH_MAX_PLY][2];
+} search_t;
+
+typedef struct
+{
+    search_t s;
+    colour_t turn;
+    move_list_t root;
+    pthread_t thread;
+} helper_t;
+
+
+/* counts stop_search calls; searches stop when it moves past the count
+ * they started with, so concurrent searches never reset each other's stop */
+static atomic_uint stop_requests = 0;
+static _Atomic uint64_t total_nodes = 0;
+
+static const int piece_values[PIECE_TYPE_COUNT] = { 0, 100, 320, 330, 500, 900, 0 };
+
+/* from white's point of view with a8 first, black reads them mirrored */
+static const int piece_square[PIECE_TYPE_COUNT][64] =
+{
+    [PIECE_TYPE_PAWN] =
+    {
+          0,   0,   0,   0,   0,   0,   0,   0,
+         50,  50,  50,  50,  50,  50,  50,  50,
+         10,  10,  20,  30,  30,  20,  10,  10,
+          5,   5,  10,  25,  25,  10,   5,   5,
+          0,   0,   0,  20,  20,   0,   0,   0,
+          5,  -5, -10,   0,   0, -10,  -5,   5,
+          5,  10,  10, -20, -20,  10,  10,   5,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [PIECE_TYPE_KNIGHT] =
+    {
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20,   0,   0,   0,   0, -20, -40,
+        -30,   0,  10,  15,  15,  10,   0, -30,
+        -30,   5,  15,  20,  20,  15,   5, -30,
+        -30,   0,  15,  20,  20,  15,   0, -30,
+        -30,   5,  10,  15,  15,  10,   5, -30,
+        -40, -20,   0,   5,   5,   0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50,
+    },
+    [PIECE_TYPE_BISHOP] =
+    {
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,  10,  10,   5,   0, -10,
+        -10,   5,   5,  10,  10,   5,   5, -10,
+        -10,   0,  10,  10,  10,  10,   0, -10,
+        -10,  10,  10,  10,  10,  10,  10, -10,
+        -10,   5,   0,   0,   0,   0,   5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20,
+    },
+    [PIECE_TYPE_ROOK] =
+    {
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,  10,  10,  10,  10,  10,  10,   5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+          0,   0,   0,   5,   5,   0,   0,   0,
+    },
+    [PIECE_TYPE_QUEEN] =
+    {
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,   5,   5,   5,   0, -10,
+         -5,   0,   5,   5,   5,   5,   0,  -5,
+          0,   0,   5,   5,   5,   5,   0,  -5,
+        -10,   5,   5,   5,   5,   5,   0, -10,
+        -10,   0,   5,   0,   0,   0,   0, -10,
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+    },
+    [PIECE_TYPE_KING] =
+    {
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+         20,  20,   0,   0,   0,   0,  20,  20,
+         20,  30,  10,   0,   0,  10,  30,  20,
+    },
+};
+
+
+void movegen_search_default_limits(search_limits_t* limits)
+{
+    limits->max_depth = SEARCH_MAX_DEPTH;
+    limits->max_time_ms = SEARCH_DEFAULT_TIME_MS;
+    limits->max_nodes = 0;
+    limits->threads = 1;
+}
+
+
+void movegen_search_set_limits(search_limits_t* limits, int max_depth, int max_time_ms, long max_nodes)
+{
+    /* zero leaves the time or node budget unbounded */
+    if (max_depth <= 0 || max_depth > SEARCH_MAX_DEPTH)
+        max_depth = SEARCH_MAX_DEPTH;
+    limits->max_depth = max_depth;
+    limits->max_time_ms = max_time_ms > 0 ? max_time_ms : 0;
+    limits->max_nodes = max_nodes > 0 ? max_nodes : 0;
+}
+
+
+void movegen_search_set_threads(search_limits_t* limits, int threads)
+{
+    if (threads < 1)
+        threads = 1;
+    if (threads > SEARCH_MAX_THREADS)
+        threads = SEARCH_MAX_THREADS;
+    limits->threads = threads;
+}
+
+
+uint64_t movegen_search_total_nodes(void)
+{
+    /* every node searched since start up, helpers included, by all games */
+    return atomic_load(&total_nodes);
+}
+
+
+void movegen_search_stop(void)
+{
+    /* may come from another thread, every search running then notices at
+     * its next check */
+    atomic_fetch_add(&stop_requests, 1);
+}
+
+
+static colour_t other_colour(colour_t colour)
+{
+    return (colour == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+}
+
+
+static int evaluate(board_t* board, colour_t turn)
+{
+    /* material plus piece-square tables, which only exist for 8x8 */
+    STATS_COUNT(STAT_EVALUATIONS);
+    bool use_tables = board->width == 8 && board->height == 8;
+    int score = 0;
+    for (colour_t c = COLOUR_WHITE; c <= COLOUR_BLACK; c++)
+    {
+        int sign = (c == COLOUR_WHITE) ? 1 : -1;
+        for (int i = find_next_piece(board, c, 0); i >= 0; i = find_next_piece(board, c, i + 1))
+        {
+            piece_type_t type = get_piece(board, i)->type;
+            int value = piece_values[type];
+            if (use_tables)
+                value += piece_square[type][(c == COLOUR_WHITE) ? i : i ^ 56];
+            score += sign * value;
+        }
+    }
+    return (turn == COLOUR_WHITE) ? score : -score;
+}
+
+
+int movegen_search_evaluate(board_t* board, colour_t turn)
+{
+    /* the static evaluation in centipawns, for the side to move */
+    return evaluate(board, turn);
+}
+
+
+static piece_type_t captured_type(board_t* board, move_t* m)
+{
+    piece_t* target = get_piece(board, m->to);
+    if (target->type != PIECE_TYPE_EMPTY)
+        return target->type;
+    piece_t* p = get_piece(board, m->from);
+    if (p->type == PIECE_TYPE_PAWN && index_to_x(board, m->from) != index_to_x(board, m->to))
+        return PIECE_TYPE_PAWN;
+    return PIECE_TYPE_EMPTY;
+}
+
+
+static int score_move(search_t* s, move_t* m, const move_t* hash_move, int ply)
+{
+    if (hash_move && move_equal(m, hash_move))
+        return 200000;
+    piece_type_t victim = captured_type(s->board, m);
+    if (victim != PIECE_TYPE_EMPTY)
+    {
+        /* most valuable victim, least valuable attacker */
+        piece_type_t attacker = get_piece(s->board, m->from)->type;
+        return 100000 + 10 * piece_values[victim] - piece_values[attacker];
+    }
+    if (m->promotion != PIECE_TYPE_EMPTY)
+        return 90000 + piece_values[m->promotion];
+    if (ply < SEARCH_MAX_PLY)
+    {
+        if (move_equal(m, &s->killers[ply][0]))
+            return 80000;
+        if (move_equal(m, &s->killers[ply][1]))
+            return 70000;
+    }
+    return 0;
+}
+
+
+static void order_moves(search_t* s, move_t* moves, int count, const move_t* hash_move, int ply)
+{
+    int scores[MOVE_LIST_CAPACITY];
+    for (int i = 0; i < count; i++)
+        scores[i] = score_move(s, &moves[i], hash_move, ply);
+    /* insertion sort, move lists are short */
+    for (int i = 1; i < count; i++)
+    {
+        move_t m = moves[i];
+        int score = scores[i];
+        int j = i - 1;
+        for (; j >= 0 && scores[j] < score; j--)
+        {
+            moves[j + 1] = moves[j];
+            scores[j + 1] = scores[j];
+        }
+        moves[j + 1] = m;
+        scores[j + 1] = score;
+    }
+}
+
+
+static void store_killer(search_t* s, move_t* m, int ply)
+{
+    if (ply >= SEARCH_MAX_PLY || move_equal(m, &s->killers[ply][0]))
+        return;
+    s->killers[ply][1] = s->killers[ply][0];
+    s->killers[ply][0] = *m;
+}
+
+
+static int score_to_tt(int score, int ply)
+{
+    /* mate scores are stored relative to the node, not the root */
+    if (score >= SEARCH_MATE - SEARCH_MAX_PLY)
+        return score + ply;
+    if (score <= -SEARCH_MATE + SEARCH_MAX_PLY)
+        return score - ply;
+    return score;
+}
+
+
+static int score_from_tt(int score, int ply)
+{
+    if (score >= SEARCH_MATE - SEARCH_MAX_PLY)
+        return score - ply;
+    if (score <= -SEARCH_MATE + SEARCH_MAX_PLY)
+        return score + ply;
+    return score;
+}
+
+
+static bool should_stop(search_t* s)
+{
+    if (s->stopped)
+        return true;
+    if (s->nodes % SEARCH_CHECK_INTERVAL)
+        return false;
+    if (atomic_load(&stop_requests) != s->stop_epoch
+        || (s->helper && atomic_load(s->helpers_stop))
+        || (!s->helper && s->limits.max_nodes && s->nodes >= s->limits.max_nodes)
+        || (s->deadline_us && monotonic_us() >= s->deadline_us))
+    {
+        s->stopped = true;
+    }
+    return s->stopped;
+}
+
+
+static bool is_draw(search_t* s, colour_t turn, bool in_check)
+{
+    /* a repeat of any position on the way here, in the search or in the
+     * game before it, is scored as a draw the first time: if going back
+     * was best once it is best again. Nothing from before the last
+     * capture or pawn move can repeat, and only the plies since then
+     * count towards the fifty move rule */
+    uint64_t hash = s->board->hash;
+    int clock = 0;
+    bool reversible = true;
+    for (unsigned i = s->undo.count; i-- > 0;)
+    {
+        const undo_t* u = &s->undo.entries[i];
+        if (u->moved.type == PIECE_TYPE_PAWN || u->captured.type != PIECE_TYPE_EMPTY)
+        {
+            reversible = false;
+            break;
+        }
+        clock++;
+        if (u->hash == hash)
+            return true;
+    }
+    if (reversible && s->history)
+    {
+        clock += s->history->halfmove_clock;
+        /* the last is the root, which the path already covers */
+        for (unsigned i = 0; i + 1 < s->history->count; i++)
+        {
+            if (s->history->hashes[i] == hash)
+                return true;
+        }
+    }
+    /* a mate on the last move stands over the fifty move rule */
+    if (clock >= GAME_FIFTY_MOVE_PLIES)
+        return !in_check || has_legal_moves(s->board, turn);
+    return false;
+}
+
+
+static int quiesce(search_t* s, colour_t turn, int alpha, int beta, int ply)
+{
+    s->nodes++;
+    if (should_stop(s))
+        return 0;
+
+    int stand_pat = evaluate(s->board, turn);
+    if (stand_pat >= beta)
+        return beta;
+    if (stand_pat > alpha)
+        alpha = stand_pat;
+    if (ply >= SEARCH_MAX_PLY)
+        return alpha;
+
+    move_list_t list;
+    generate_all_moves(s->board, turn, &list);
+    move_t* moves = list.moves;
+    int noisy = 0;
+    for (int i = 0; i < list.count; i++)
+    {
+        if (moves[i].promotion != PIECE_TYPE_EMPTY
+            || captured_type(s->board, &moves[i]) != PIECE_TYPE_EMPTY)
+        {
+            moves[noisy++] = moves[i];
+        }
+    }
+    order_moves(s, moves, noisy, NULL, ply);
+
+    for (int i = 0; i < noisy; i++)
+    {
+        push_move(s->board, &s->undo, &moves[i]);
+        int score = -quiesce(s, other_colour(turn), -beta, -alpha, ply + 1);
+        pop_move(s->board, &s->undo);
+        if (s->stopped)
+            return 0;
+        if (score >= beta)
+            return beta;
+        if (score > alpha)
+            alpha = score;
+    }
+    return alpha;
+}
+
+
+static int negamax(search_t* s, colour_t turn, int depth, int alpha, int beta, int ply)
+{
+    /* before the table, whose scores don't know how the node was reached */
+    bool in_check = is_in_check(s->board, turn);
+    if (is_draw(s, turn, in_check))
+        return 0;
+    if (in_check && ply < SEARCH_MAX_PLY)
+        depth++;
+    if (depth <= 0 || ply >= SEARCH_MAX_PLY)
+        return quiesce(s, turn, alpha, beta, ply);
+
+    s->nodes++;
+    if (should_stop(s))
+        return 0;
+
+    uint64_t key = s->board->hash;
+    tt_result_t hit;
+    const move_t* hash_move = NULL;
+    if (tt_probe(key, &hit))
+    {
+        hash_move = &hit.move;
+        int score = score_from_tt(hit.score, ply);
+        if (hit.depth >= depth
+            && (hit.bound == TT_BOUND_EXACT
+                || (hit.bound == TT_BOUND_LOWER && score >= beta)
+                || (hit.bound == TT_BOUND_UPPER && score <= alpha)))
+        {
+            return score;
+        }
+    }
+
+    move_list_t list;
+    if (!generate_all_moves(s->board, turn, &list))
+        return in_check ? -SEARCH_MATE + ply : 0;
+    move_t* moves = list.moves;
+    int count = list.count;
+    order_moves(s, moves, count, hash_move, ply);
+
+    int original_alpha = alpha;
+    int best = -SEARCH_INFINITY;
+    move_t* best_move = &moves[0];
+    for (int i = 0; i < count; i++)
+    {
+        bool quiet = moves[i].promotion == PIECE_TYPE_EMPTY
+            && captured_type(s->board, &moves[i]) == PIECE_TYPE_EMPTY;
+        push_move(s->board, &s->undo, &moves[i]);
+        int score = -negamax(s, other_colour(turn), depth - 1, -beta, -alpha, ply + 1);
+        pop_move(s->board, &s->undo);
+        if (s->stopped)
+            return 0;
+        if (score > best)
+        {
+            best = score;
+            best_move = &moves[i];
+        }
+        if (score > alpha)
+            alpha = score;
+        if (alpha >= beta)
+        {
+            if (quiet)
+                store_killer(s, &moves[i], ply);
+            break;
+        }
+    }
+
+    tt_bound_t bound = TT_BOUND_EXACT;
+    if (best <= original_alpha)
+        bound = TT_BOUND_UPPER;
+    else if (best >= beta)
+        bound = TT_BOUND_LOWER;
+    tt_store(key, depth, score_to_tt(best, ply), bound, best_move);
+    return best;
+}
+
+
+static int search_root(search_t* s, colour_t turn, int depth, move_t* moves, int count, int* best_index)
+{
+    int alpha = -SEARCH_INFINITY;
+    int beta = SEARCH_INFINITY;
+    *best_index = -1;
+    for (int i = 0; i < count; i++)
+    {
+        push_move(s->board, &s->undo, &moves[i]);
+        int score = -negamax(s, other_colour(turn), depth - 1, -beta, -alpha, 1);
+        pop_move(s->board, &s->undo);
+        if (s->stopped)
+            return 0;
+        if (score > alpha)
+        {
+            alpha = score;
+            *best_index = i;
+        }
+    }
+    return alpha;
+}
+
+
+static void iterate(search_t* s, colour_t turn, move_list_t* root, move_t* move)
+{
+    /* iterative deepening, an interrupted iteration is thrown away and the
+     * best move of each finished one is searched first in the next */
+    move_t* moves = root->moves;
+    for (int depth = 1 + s->depth_offset; depth <= s->limits.max_depth; depth++)
+    {
+        int best_index = -1;
+        int score = search_root(s, turn, depth, moves, root->count, &best_index);
+        if (s->stopped || best_index < 0)
+            break;
+        move_t best = moves[best_index];
+        memmove(&moves[1], &moves[0], sizeof(move_t) * best_index);
+        moves[0] = best;
+        *move = best;
+        tt_store(s->board->hash, depth, score, TT_BOUND_EXACT, &best);
+        if (score >= SEARCH_MATE - SEARCH_MAX_PLY)
+            break;
+    }
+}
+
+
+static void* helper_main(void* arg)
+{
+    helper_t* h = arg;
+    move_t move;
+    iterate(&h->s, h->turn, &h->root, &move);
+    return NULL;
+}
+
+
+static int start_helpers(helper_t* helpers, int count, const search_t* primary, colour_t turn, const move_list_t* root)
+{
+    /* lazy SMP: helpers search the same root on their own boards and only
+     * share what they find through the transposition table; half of them
+     * run a ply ahead so they fill it with deeper results */
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SEARCH_THREAD_STACK);
+    int started = 0;
+    for (; started < count; started++)
+    {
+        helper_t* h = &helpers[started];
+        memset(&h->s, 0, sizeof(h->s));
+        h->s.board = duplicate_board(primary->board);
+        h->s.limits = primary->limits;
+        h->s.deadline_us = primary->deadline_us;
+        h->s.helper = true;
+        h->s.stop_epoch = primary->stop_epoch;
+        h->s.helpers_stop = primary->helpers_stop;
+        h->s.history = primary->history;
+        h->s.depth_offset = (started + 1) & 1;
+        h->turn = turn;
+        h->root = *root;
+        if (pthread_create(&h->thread, &attr, helper_main, h))
+        {
+            /* a wasm build without threads lands here, and searches alone */
+            destroy_board(h->s.board);
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+    return started;
+}
+
+
+static void stop_helpers(atomic_bool* helpers_stop, helper_t* helpers, int count)
+{
+    atomic_store(helpers_stop, true);
+    for (int i = 0; i < count; i++)
+    {
+        pthread_join(helpers[i].thread, NULL);
+        atomic_fetch_add(&total_nodes, (uint64_t)helpers[i].s.nodes);
+        STATS_ADD(STAT_NODES, helpers[i].s.nodes);
+        destroy_board(helpers[i].s.board);
+    }
+}
+
+
+bool movegen_search_generator(game_config_t* config, board_t* board, colour_t turn, const move_list_t* legal_moves, arena_t* scratch, move_t* move, game_status_t status, const game_history_t* history)
+{
+    if (legal_moves->count == 0)
+        return false;
+    /* a copy, the root list is reordered between iterations */
+    move_list_t list = *legal_moves;
+
+    unsigned stop_epoch = atomic_load(&stop_requests);
+    atomic_bool helpers_stop = false;
+    search_t s;
+    memset(&s, 0, sizeof(s));
+    s.board = board;
+    s.limits = config->search;
+    s.stop_epoch = stop_epoch;
+    s.helpers_stop = &helpers_stop;
+    s.history = history;
+    if (s.limits.max_time_ms)
+        s.deadline_us = monotonic_us() + (uint64_t)s.limits.max_time_ms * 1000u;
+
+    tt_new_search();
+    tt_result_t hit;
+    order_moves(&s, list.moves, list.count, tt_probe(board->hash, &hit) ? &hit.move : NULL, 0);
+    *move = list.moves[0];
+    if (list.count == 1)
+        return true;
+
+    helper_t* helpers = NULL;
+    int helper_count = 0;
+    if (s.limits.threads > 1)
+    {
+        helpers = malloc(sizeof(helper_t) * (s.limits.threads - 1));
+        if (helpers)
+            helper_count = start_helpers(helpers, s.limits.threads - 1, &s, turn, &list);
+    }
+    iterate(&s, turn, &list, move);
+    atomic_fetch_add(&total_nodes, (uint64_t)s.nodes);
+    STATS_ADD(STAT_NODES, s.nodes);
+    stop_helpers(&helpers_stop, helpers, helper_count);
+    free(helpers);
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "move.h"
+#include "game.h"
+
+
+#define SEARCH_MAX_DEPTH                32
+#define SEARCH_DEFAULT_TIME_MS          250
+#define SEARCH_MAX_THREADS              64
+
+
+bool movegen_search_generator(game_config_t* config, board_t* board, colour_t turn, const move_list_t* legal_moves, arena_t* scratch, move_t* move, game_status_t status, const game_history_t* history);
+void movegen_search_default_limits(search_limits_t* limits);
+void movegen_search_set_limits(search_limits_t* limits, int max_depth, int max_time_ms, long max_nodes);
+void movegen_search_set_threads(search_limits_t* limits, int threads);
+uint64_t movegen_search_total_nodes(void);
+int movegen_search_evaluate(board_t* board, colour_t turn);
+void movegen_search_stop(void);
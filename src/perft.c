@@ -0,0 +1,55 @@
+#include <stdint.h>
+
+#include "board.h"
+#include "move.h"
+#include "rules.h"
+
+#include "perft.h"
+
+
+static uint64_t perft_by_square(board_t* board, colour_t turn, int depth)
+{
+    /* for positions with more moves than a move list holds */
+    colour_t next = (turn == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+    int max_moves = max_piece_moves(board);
+    move_t moves[max_moves];
+    uint64_t nodes = 0;
+    for (int i = find_next_piece(board, turn, 0); i >= 0; i = find_next_piece(board, turn, i + 1))
+    {
+        int count = generate_moves(board, i, moves, max_moves);
+        for (int j = 0; j < count; j++)
+        {
+            undo_t undo;
+            make_move(board, &moves[j], &undo);
+            nodes += perft(board, next, depth - 1);
+            unmake_move(board, &undo);
+        }
+    }
+    return nodes;
+}
+
+
+uint64_t perft(board_t* board, colour_t turn, int depth)
+{
+    /* counts the leaf nodes of the legal move tree, the last ply is bulk
+     * counted from the generated list rather than played out */
+    if (depth <= 0)
+        return 1;
+    move_list_t list;
+    generate_all_moves(board, turn, &list);
+    if (list.truncated)
+        return perft_by_square(board, turn, depth);
+    if (depth == 1)
+        return list.count;
+
+    colour_t next = (turn == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+    uint64_t nodes = 0;
+    for (int i = 0; i < list.count; i++)
+    {
+        undo_t undo;
+        make_move(board, &list.moves[i], &undo);
+        nodes += perft(board, next, depth - 1);
+        unmake_move(board, &undo);
+    }
+    return nodes;
+}
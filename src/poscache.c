@@ -0,0 +1,239 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "poscache.h"
+
+
+#define POSCACHE_NONE           -1
+
+
+/* best moves depend on the engine settings as well as the position, so each
+ * is stamped with the epoch it was found in, and changing a setting starts a
+ * new one */
+static atomic_uint best_move_epoch = 1;
+
+
+bool poscache_init(poscache_t* cache, unsigned capacity)
+{
+    /* a capacity of zero leaves the cache off, every lookup misses */
+    memset(cache, 0, sizeof(poscache_t));
+    cache->head = POSCACHE_NONE;
+    cache->tail = POSCACHE_NONE;
+    if (!capacity)
+        return true;
+    if (capacity > POSCACHE_MAX_ENTRIES)
+        capacity = POSCACHE_MAX_ENTRIES;
+    unsigned bucket_count = 1;
+    while (bucket_count < capacity)
+        bucket_count *= 2;
+    cache->entries = malloc(sizeof(poscache_entry_t) * capacity);
+    cache->buckets = malloc(sizeof(int) * bucket_count);
+    if (!cache->entries || !cache->buckets)
+    {
+        poscache_destroy(cache);
+        return false;
+    }
+    cache->capacity = capacity;
+    cache->bucket_mask = bucket_count - 1;
+    poscache_clear(cache);
+    return true;
+}
+
+
+void poscache_destroy(poscache_t* cache)
+{
+    free(cache->entries);
+    free(cache->buckets);
+    memset(cache, 0, sizeof(poscache_t));
+    cache->head = POSCACHE_NONE;
+    cache->tail = POSCACHE_NONE;
+}
+
+
+void poscache_clear(poscache_t* cache)
+{
+    if (cache->buckets)
+    {
+        for (unsigned i = 0; i <= cache->bucket_mask; i++)
+            cache->buckets[i] = POSCACHE_NONE;
+    }
+    cache->used = 0;
+    cache->head = POSCACHE_NONE;
+    cache->tail = POSCACHE_NONE;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->best_move_hits = 0;
+    cache->evictions = 0;
+}
+
+
+static int find_entry(const poscache_t* cache, uint64_t key)
+{
+    if (!cache->capacity)
+        return POSCACHE_NONE;
+    int i = cache->buckets[key & cache->bucket_mask];
+    while (i != POSCACHE_NONE && cache->entries[i].key != key)
+        i = cache->entries[i].chain;
+    return i;
+}
+
+
+static void unlink_recent(poscache_t* cache, int i)
+{
+    poscache_entry_t* e = &cache->entries[i];
+    if (e->prev != POSCACHE_NONE)
+        cache->entries[e->prev].next = e->next;
+    else
+        cache->head = e->next;
+    if (e->next != POSCACHE_NONE)
+        cache->entries[e->next].prev = e->prev;
+    else
+        cache->tail = e->prev;
+}
+
+
+static void push_recent(poscache_t* cache, int i)
+{
+    poscache_entry_t* e = &cache->entries[i];
+    e->prev = POSCACHE_NONE;
+    e->next = cache->head;
+    if (cache->head != POSCACHE_NONE)
+        cache->entries[cache->head].prev = i;
+    cache->head = i;
+    if (cache->tail == POSCACHE_NONE)
+        cache->tail = i;
+}
+
+
+static void touch(poscache_t* cache, int i)
+{
+    if (cache->head == i)
+        return;
+    unlink_recent(cache, i);
+    push_recent(cache, i);
+}
+
+
+static void unlink_bucket(poscache_t* cache, int i)
+{
+    int* link = &cache->buckets[cache->entries[i].key & cache->bucket_mask];
+    while (*link != i)
+        link = &cache->entries[*link].chain;
+    *link = cache->entries[i].chain;
+}
+
+
+static int claim_entry(poscache_t* cache, uint64_t key)
+{
+    /* a free entry while there are any, then the least recently used */
+    int i;
+    if (cache->used < cache->capacity)
+    {
+        i = (int)cache->used++;
+    }
+    else
+    {
+        i = cache->tail;
+        unlink_recent(cache, i);
+        unlink_bucket(cache, i);
+        cache->evictions++;
+    }
+    poscache_entry_t* e = &cache->entries[i];
+    e->key = key;
+    e->best_epoch = 0;
+    int* bucket = &cache->buckets[key & cache->bucket_mask];
+    e->chain = *bucket;
+    *bucket = i;
+    push_recent(cache, i);
+    return i;
+}
+
+
+bool poscache_lookup(poscache_t* cache, uint64_t key, int* status, move_list_t* legal_moves)
+{
+    if (!cache->capacity)
+        return false;
+    int i = find_entry(cache, key);
+    if (i == POSCACHE_NONE)
+    {
+        cache->misses++;
+        return false;
+    }
+    cache->hits++;
+    touch(cache, i);
+    const poscache_entry_t* e = &cache->entries[i];
+    *status = e->status;
+    legal_moves->count = e->legal_moves.count;
+    legal_moves->truncated = e->legal_moves.truncated;
+    memcpy(legal_moves->moves, e->legal_moves.moves, sizeof(move_t) * e->legal_moves.count);
+    return true;
+}
+
+
+void poscache_store(poscache_t* cache, uint64_t key, int status, const move_list_t* legal_moves)
+{
+    if (!cache->capacity)
+        return;
+    int i = find_entry(cache, key);
+    if (i == POSCACHE_NONE)
+        i = claim_entry(cache, key);
+    else
+        touch(cache, i);
+    poscache_entry_t* e = &cache->entries[i];
+    e->status = status;
+    e->legal_moves.count = legal_moves->count;
+    e->legal_moves.truncated = legal_moves->truncated;
+    memcpy(e->legal_moves.moves, legal_moves->moves, sizeof(move_t) * legal_moves->count);
+}
+
+
+bool poscache_best_move(poscache_t* cache, uint64_t key, move_t* move)
+{
+    int i = find_entry(cache, key);
+    if (i == POSCACHE_NONE || cache->entries[i].best_epoch != atomic_load(&best_move_epoch))
+        return false;
+    cache->best_move_hits++;
+    touch(cache, i);
+    *move = cache->entries[i].best_move;
+    return true;
+}
+
+
+void poscache_store_best_move(poscache_t* cache, uint64_t key, const move_t* move, unsigned epoch)
+{
+    /* epoch is the one read before the move was looked for, so a setting
+     * changed meanwhile, or a stopped search, leaves the move stale */
+    int i = find_entry(cache, key);
+    if (i == POSCACHE_NONE)
+        return;
+    cache->entries[i].best_move = *move;
+    cache->entries[i].best_epoch = epoch;
+}
+
+
+unsigned poscache_epoch(void)
+{
+    return atomic_load(&best_move_epoch);
+}
+
+
+void poscache_forget_best_moves(void)
+{
+    /* may come from another thread, as stop_search does */
+    if (atomic_fetch_add(&best_move_epoch, 1) + 1 == 0)
+        atomic_fetch_add(&best_move_epoch, 1);
+}
+
+
+void poscache_get_stats(const poscache_t* cache, poscache_stats_t* stats)
+{
+    stats->capacity = cache->capacity;
+    stats->used = cache->used;
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->best_move_hits = cache->best_move_hits;
+    stats->evictions = cache->evictions;
+}
@@ -2,12 +2,27 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "attacks.h"
 #include "board.h"
 #include "move.h"
+#include "rules.h"
+#include "stats.h"
 #include "util.h"
+#include "zobrist.h"
 
 
-static bool is_pawn_last_rank(board_t* board, move_t* m)
+typedef struct
+{
+    int king;               /* -1 when the side has no king to protect */
+    int checkers;
+    int checker;            /* the checking piece when there is only one */
+    bool check_slider;      /* whether the check can be blocked */
+    int pin_count;
+    int pinned[ATTACK_DIRECTIONS];
+} legality_t;
+
+
+bool is_pawn_last_rank(board_t* board, move_t* m)
 {
     piece_t* p = get_piece(board, m->from);
     if (PIECE_TYPE_PAWN != p->type)
@@ -59,9 +74,8 @@ static bool is_pawn_move_legal(board_t* board, move_t* m, colour_t colour)
             return true;
         }
 
-        int captured_idx = m->to - ((colour == COLOUR_WHITE) ? board->width : -board->width);
-        piece_t* captured = get_piece(board, captured_idx);
-        if (captured->type == PIECE_TYPE_PAWN && captured->colour != colour)
+        /* en passant only onto the square the last double push skipped */
+        if (m->to == board->en_passant)
         {
             return true;
         }
@@ -160,6 +174,30 @@ static bool is_queen_move_legal(board_t* board, move_t* m)
 }
 
 
+static unsigned castle_right(colour_t colour, bool king_side)
+{
+    unsigned right = king_side ? CASTLE_WHITE_KING : CASTLE_WHITE_QUEEN;
+    return (colour == COLOUR_WHITE) ? right : right << 2;
+}
+
+
+static unsigned castling_lost(const board_t* board, int sq)
+{
+    /* each right goes with its rook's corner, and is lost once anything
+     * leaves or lands on it */
+    int white_rank = (board->height - 1) * board->width;
+    if (sq == white_rank)
+        return CASTLE_WHITE_QUEEN;
+    if (sq == white_rank + board->width - 1)
+        return CASTLE_WHITE_KING;
+    if (sq == 0)
+        return CASTLE_BLACK_QUEEN;
+    if (sq == board->width - 1)
+        return CASTLE_BLACK_KING;
+    return 0;
+}
+
+
 static bool is_king_move_legal(board_t* board, move_t* m)
 {
     int from_x = index_to_x(board, m->from);
@@ -184,6 +222,11 @@ static bool is_king_move_legal(board_t* board, move_t* m)
     if (dx == 2 && dy == 0)
     {
         bool king_side = (to_x > from_x);
+        int back_rank = (piece->colour == COLOUR_WHITE) ? 0 : board->height - 1;
+        if (from_y != back_rank || !(board->castling & castle_right(piece->colour, king_side)))
+        {
+            return false;
+        }
         int rook_from_x = king_side ? board->width - 1 : 0;
         int rook_from = coords_to_index(board, rook_from_x, from_y);
         piece_t* rook = get_piece(board, rook_from);
@@ -208,6 +251,7 @@ static bool is_king_move_legal(board_t* board, move_t* m)
 
 bool is_move_legal(board_t* board, move_t* m)
 {
+    STATS_COUNT(STAT_IS_MOVE_LEGAL);
     piece_t* p = get_piece(board, m->from);
     piece_t* target = get_piece(board, m->to);
 
@@ -240,24 +284,151 @@ bool is_move_legal(board_t* board, move_t* m)
 }
 
 
-static bool is_square_attacked(board_t* board, int sq_index, colour_t by_colour)
+static colour_t other_colour(colour_t colour)
 {
-    for (int i = 0; i < board->width * board->height; i++)
+    return (colour == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+}
+
+
+static bool is_piece(const board_t* board, int sq, colour_t colour, piece_type_t type)
+{
+    piece_t* p = get_piece(board, sq);
+    return p->type == type && p->colour == colour;
+}
+
+
+static bool list_has_piece(const board_t* board, const int* list, colour_t colour, piece_type_t type)
+{
+    for (; *list != ATTACK_LIST_END; list++)
     {
-        piece_t* p = get_piece(board, i);
-        if (p->type == PIECE_TYPE_EMPTY || p->colour != by_colour)
+        if (is_piece(board, *list, colour, type))
+            return true;
+    }
+    return false;
+}
+
+
+static int ray_blocker(const board_t* board, direction_t dir, int sq)
+{
+    /* first occupied square along the ray, or ATTACK_LIST_END */
+    const attack_tables_t* t = board->attacks;
+    if (board->has_bitboards)
+    {
+        bitboard_t blockers = t->ray_mask[dir][sq]
+            & (board->occupied[COLOUR_WHITE] | board->occupied[COLOUR_BLACK]);
+        if (!blockers)
+            return ATTACK_LIST_END;
+        return t->ray_ascending[dir] ? bitboard_lsb(blockers) : bitboard_msb(blockers);
+    }
+    const int* ray = attacks_ray(t, dir, sq);
+    for (; *ray != ATTACK_LIST_END; ray++)
+    {
+        if (get_piece(board, *ray)->type != PIECE_TYPE_EMPTY)
+            return *ray;
+    }
+    return ATTACK_LIST_END;
+}
+
+
+static bool is_slider_for(piece_type_t type, direction_t dir)
+{
+    if (type == PIECE_TYPE_QUEEN)
+        return true;
+    return type == (DIRECTION_IS_DIAGONAL(dir) ? PIECE_TYPE_BISHOP : PIECE_TYPE_ROOK);
+}
+
+
+static bitboard_t slider_attackers(const board_t* board, int sq, colour_t by_colour)
+{
+    bitboard_t attackers = 0;
+    for (int d = 0; d < ATTACK_DIRECTIONS; d++)
+    {
+        int blocker = ray_blocker(board, d, sq);
+        if (blocker == ATTACK_LIST_END)
             continue;
+        piece_t* p = get_piece(board, blocker);
+        if (p->colour == by_colour && is_slider_for(p->type, d))
+            attackers |= bitboard_square(blocker);
+    }
+    return attackers;
+}
+
+
+static bitboard_t attackers_mask(const board_t* board, int sq, colour_t by_colour)
+{
+    const attack_tables_t* t = board->attacks;
+    const bitboard_t* pieces = board->pieces[by_colour];
+    return (t->pawn_mask[other_colour(by_colour)][sq] & pieces[PIECE_TYPE_PAWN])
+        | (t->knight_mask[sq] & pieces[PIECE_TYPE_KNIGHT])
+        | (t->king_mask[sq] & pieces[PIECE_TYPE_KING])
+        | slider_attackers(board, sq, by_colour);
+}
 
-        move_t m = { .from = i, .to = sq_index, .promotion = PIECE_TYPE_EMPTY };
-        if (is_move_legal(board, &m))
+
+bool is_square_attacked(board_t* board, int sq_index, colour_t by_colour)
+{
+    STATS_COUNT(STAT_IS_SQUARE_ATTACKED);
+    const attack_tables_t* t = board->attacks;
+    if (board->has_bitboards)
+        return !!attackers_mask(board, sq_index, by_colour);
+
+    if (list_has_piece(board, attacks_pawn(t, other_colour(by_colour), sq_index), by_colour, PIECE_TYPE_PAWN)
+        || list_has_piece(board, attacks_knight(t, sq_index), by_colour, PIECE_TYPE_KNIGHT)
+        || list_has_piece(board, attacks_king(t, sq_index), by_colour, PIECE_TYPE_KING))
+    {
+        return true;
+    }
+    for (int d = 0; d < ATTACK_DIRECTIONS; d++)
+    {
+        int blocker = ray_blocker(board, d, sq_index);
+        if (blocker == ATTACK_LIST_END)
+            continue;
+        piece_t* p = get_piece(board, blocker);
+        if (p->colour == by_colour && is_slider_for(p->type, d))
             return true;
     }
     return false;
 }
 
 
+int count_attackers(board_t* board, int sq_index, colour_t by_colour)
+{
+    const attack_tables_t* t = board->attacks;
+    if (board->has_bitboards)
+        return bitboard_count(attackers_mask(board, sq_index, by_colour));
+
+    int count = 0;
+    const int* lists[] =
+    {
+        attacks_pawn(t, other_colour(by_colour), sq_index),
+        attacks_knight(t, sq_index),
+        attacks_king(t, sq_index),
+    };
+    const piece_type_t types[] = { PIECE_TYPE_PAWN, PIECE_TYPE_KNIGHT, PIECE_TYPE_KING };
+    for (unsigned i = 0; i < sizeof(lists) / sizeof(lists[0]); i++)
+    {
+        for (const int* sq = lists[i]; *sq != ATTACK_LIST_END; sq++)
+            count += is_piece(board, *sq, by_colour, types[i]);
+    }
+    for (int d = 0; d < ATTACK_DIRECTIONS; d++)
+    {
+        int blocker = ray_blocker(board, d, sq_index);
+        if (blocker == ATTACK_LIST_END)
+            continue;
+        piece_t* p = get_piece(board, blocker);
+        count += p->colour == by_colour && is_slider_for(p->type, d);
+    }
+    return count;
+}
+
+
 int find_king(board_t* board, colour_t colour)
 {
+    if (board->has_bitboards)
+    {
+        bitboard_t kings = board->pieces[colour][PIECE_TYPE_KING];
+        return kings ? bitboard_lsb(kings) : -1;
+    }
     for (int i = 0; i < board->width * board->height; i++)
     {
         piece_t* p = get_piece(board, i);
@@ -268,132 +439,524 @@ int find_king(board_t* board, colour_t colour)
 }
 
 
+bool can_take_en_passant(const board_t* board, int sq, colour_t colour)
+{
+    /* whether a pawn of colour stands beside the enemy pawn that skipped
+     * sq, so the en passant square is worth keeping */
+    int victim = sq + ((colour == COLOUR_WHITE) ? board->width : -board->width);
+    if (victim < 0 || victim >= board->width * board->height
+        || !is_piece(board, victim, other_colour(colour), PIECE_TYPE_PAWN))
+    {
+        return false;
+    }
+    int x = victim % board->width;
+    return (x > 0 && is_piece(board, victim - 1, colour, PIECE_TYPE_PAWN))
+        || (x < board->width - 1 && is_piece(board, victim + 1, colour, PIECE_TYPE_PAWN));
+}
+
+
 bool is_in_check(board_t* board, colour_t colour)
 {
     int king_sq = find_king(board, colour);
     if (king_sq < 0)
         return false;
-    return is_square_attacked(board, king_sq, (colour == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE);
+    return is_square_attacked(board, king_sq, other_colour(colour));
 }
 
 
-bool would_move_release_check(board_t* board, board_t* consider_board, move_t* m)
+void make_move(board_t* board, const move_t* m, undo_t* undo)
 {
-    if (!copy_board(consider_board, board))
+    /* the move must be pseudo-legal and carry the flags given to it by
+     * generate_pseudo_moves */
+    STATS_COUNT(STAT_MOVES_MADE);
+    piece_t* p = get_piece(board, m->from);
+    piece_t empty = { PIECE_TYPE_EMPTY, COLOUR_NONE };
+
+    undo->move = *m;
+    undo->moved = *p;
+    undo->captured_index = m->to;
+    undo->captured = *get_piece(board, m->to);
+    undo->rook_from = -1;
+    undo->rook_to = -1;
+    undo->castling = board->castling;
+    undo->en_passant = board->en_passant;
+    undo->hash = board->hash;
+
+    if (m->flags == MOVE_FLAG_EN_PASSANT)
     {
-        raise_error(ENOMEM, "failed to copy board\n"); /* exits here */
-        return false;
+        /* en passant, the victim sits beside the pawn's starting square */
+        undo->captured_index = m->to + ((p->colour == COLOUR_WHITE) ? board->width : -board->width);
+        undo->captured = *get_piece(board, undo->captured_index);
+        set_piece(board, undo->captured_index, &empty);
+    }
+    else if (m->flags == MOVE_FLAG_CASTLING)
+    {
+        /* the rook lands on the square the king crossed */
+        int from_x = index_to_x(board, m->from);
+        bool king_side = index_to_x(board, m->to) > from_x;
+        int y = index_to_y(board, m->from);
+        undo->rook_from = coords_to_index(board, king_side ? board->width - 1 : 0, y);
+        undo->rook_to = coords_to_index(board, from_x + (king_side ? 1 : -1), y);
+        set_piece(board, undo->rook_to, get_piece(board, undo->rook_from));
+        set_piece(board, undo->rook_from, &empty);
     }
 
-    piece_t* p = get_piece(board, m->from);
-    set_piece(consider_board, m->to, p);
-    piece_t empty = { PIECE_TYPE_EMPTY, COLOUR_NONE };
-    set_piece(consider_board, m->from, &empty);
+    if (PIECE_TYPE_EMPTY != m->promotion)
+    {
+        piece_t promoted = { m->promotion, p->colour };
+        set_piece(board, m->to, &promoted);
+    }
+    else
+    {
+        set_piece(board, m->to, p);
+    }
+    set_piece(board, m->from, &empty);
 
-    if (p->type == PIECE_TYPE_PAWN && get_piece(board, m->to)->type == PIECE_TYPE_EMPTY)
+    unsigned castling = board->castling;
+    if (castling)
     {
-        if (abs(index_to_x(board, m->to) - index_to_x(board, m->from)) == 1)
-        {
-            int captured_idx = m->to - ((p->colour == COLOUR_WHITE) ? board->width : -board->width);
-            piece_t* captured = get_piece(board, captured_idx);
-            if (captured->type == PIECE_TYPE_PAWN && captured->colour != p->colour)
-                set_piece(consider_board, captured_idx, &empty);
-        }
+        castling &= ~(castling_lost(board, m->from) | castling_lost(board, m->to));
+        if (undo->moved.type == PIECE_TYPE_KING)
+            castling &= ~((undo->moved.colour == COLOUR_WHITE) ? CASTLE_WHITE : CASTLE_BLACK);
+    }
+    int en_passant = -1;
+    if (m->flags == MOVE_FLAG_DOUBLE_PUSH
+        && can_take_en_passant(board, (m->from + m->to) / 2, other_colour(undo->moved.colour)))
+    {
+        en_passant = (m->from + m->to) / 2;
+    }
+    board->hash ^= zobrist_castling(board->castling) ^ zobrist_castling(castling)
+        ^ zobrist_en_passant(board->en_passant) ^ zobrist_en_passant(en_passant)
+        ^ zobrist_side();
+    board->castling = castling;
+    board->en_passant = en_passant;
+}
+
+
+void unmake_move(board_t* board, const undo_t* undo)
+{
+    piece_t empty = { PIECE_TYPE_EMPTY, COLOUR_NONE };
+    piece_t moved = undo->moved;
+    piece_t captured = undo->captured;
+    if (undo->rook_from >= 0)
+    {
+        set_piece(board, undo->rook_from, get_piece(board, undo->rook_to));
+        set_piece(board, undo->rook_to, &empty);
     }
+    set_piece(board, undo->move.to, &empty);
+    set_piece(board, undo->captured_index, &captured);
+    set_piece(board, undo->move.from, &moved);
+    board->castling = undo->castling;
+    board->en_passant = undo->en_passant;
+    board->hash = undo->hash;
+}
+
 
-    bool in_check = is_in_check(consider_board, p->colour);
+bool would_move_release_check(board_t* board, move_t* m)
+{
+    colour_t colour = get_piece(board, m->from)->colour;
+    undo_t undo;
+    make_move(board, m, &undo);
+    bool in_check = is_in_check(board, colour);
+    unmake_move(board, &undo);
     return !in_check;
 }
 
 
-int generate_moves(board_t* board, unsigned index, bool in_check, move_t* moves, int max_moves)
+static bool is_on_board(board_t* board, int x, int y)
 {
-    if (0 >= max_moves)
-        return 0;
+    return x >= 0 && x < board->width && y >= 0 && y < board->height;
+}
 
-    int count = 0;
-    board_t* consider_board = duplicate_board(board);
-    for (int j = 0; j < board->width * board->height; j++)
+
+static bool add_move(move_t* moves, int* count, int max_moves, int from, int to, piece_type_t promotion, move_flag_t flags)
+{
+    if (*count >= max_moves)
+        return false;
+    moves[(*count)++] = move_encode(from, to, promotion, flags);
+    return true;
+}
+
+
+static bool add_pawn_move(move_t* moves, int* count, int max_moves, int from, int to, bool last_rank)
+{
+    if (!last_rank)
+        return add_move(moves, count, max_moves, from, to, PIECE_TYPE_EMPTY, MOVE_FLAG_NONE);
+    return add_move(moves, count, max_moves, from, to, PIECE_TYPE_QUEEN, MOVE_FLAG_NONE)
+        && add_move(moves, count, max_moves, from, to, PIECE_TYPE_ROOK, MOVE_FLAG_NONE)
+        && add_move(moves, count, max_moves, from, to, PIECE_TYPE_BISHOP, MOVE_FLAG_NONE)
+        && add_move(moves, count, max_moves, from, to, PIECE_TYPE_KNIGHT, MOVE_FLAG_NONE);
+}
+
+
+static void generate_pawn_moves(board_t* board, int from, move_t* moves, int* count, int max_moves)
+{
+    piece_t* p = get_piece(board, from);
+    int x = index_to_x(board, from);
+    int y = index_to_y(board, from);
+    int dir = (p->colour == COLOUR_WHITE) ? 1 : -1;
+    int start_rank = (p->colour == COLOUR_WHITE) ? 1 : board->height - 2;
+    int last_rank = (p->colour == COLOUR_WHITE) ? board->height - 1 : 0;
+    int to_y = y + dir;
+    if (!is_on_board(board, x, to_y))
+        return;
+
+    int to = coords_to_index(board, x, to_y);
+    if (get_piece(board, to)->type == PIECE_TYPE_EMPTY)
     {
-        move_t m =
-        {
-            .from = index,
-            .to = j,
-            .promotion = PIECE_TYPE_EMPTY,
-        };
-        if (is_move_legal(board, &m)
-            && (!in_check || would_move_release_check(board, consider_board, &m)))
+        if (!add_pawn_move(moves, count, max_moves, from, to, to_y == last_rank))
+            return;
+        if (y == start_rank && is_on_board(board, x, to_y + dir))
         {
-            if (is_pawn_last_rank(board, &m))
+            int double_to = coords_to_index(board, x, to_y + dir);
+            if (get_piece(board, double_to)->type == PIECE_TYPE_EMPTY
+                && !add_move(moves, count, max_moves, from, double_to, PIECE_TYPE_EMPTY, MOVE_FLAG_DOUBLE_PUSH))
             {
-#define __GENERATE_MOVES_ADD_MOVE(_m)                                   \
-                if (count < max_moves)                                  \
-                {                                                       \
-                    memcpy(&moves[count++], &_m, sizeof(move_t));       \
-                }                                                       \
-                else                                                    \
-                {                                                       \
-                    break;                                              \
-                }
-
-                m.promotion = PIECE_TYPE_ROOK;   __GENERATE_MOVES_ADD_MOVE(m)
-                m.promotion = PIECE_TYPE_KNIGHT; __GENERATE_MOVES_ADD_MOVE(m)
-                m.promotion = PIECE_TYPE_BISHOP; __GENERATE_MOVES_ADD_MOVE(m)
-                m.promotion = PIECE_TYPE_QUEEN;  __GENERATE_MOVES_ADD_MOVE(m)
+                return;
             }
-            else
+        }
+    }
+
+    for (const int* attack = attacks_pawn(board->attacks, p->colour, from); *attack != ATTACK_LIST_END; attack++)
+    {
+        to = *attack;
+        piece_t* target = get_piece(board, to);
+        if (target->type != PIECE_TYPE_EMPTY)
+        {
+            if (target->colour != p->colour
+                && !add_pawn_move(moves, count, max_moves, from, to, to_y == last_rank))
             {
-                __GENERATE_MOVES_ADD_MOVE(m)
+                return;
             }
+            continue;
+        }
+        if (to == board->en_passant
+            && !add_move(moves, count, max_moves, from, to, PIECE_TYPE_EMPTY, MOVE_FLAG_EN_PASSANT))
+        {
+            return;
         }
     }
-    destroy_board(consider_board);
-    return count;
 }
 
 
-bool generate_all_moves(board_t* board, colour_t colour, bool in_check, move_t* moves, int max_moves, int* move_count)
+static void generate_list_moves(board_t* board, int from, const int* list, move_t* moves, int* count, int max_moves)
 {
-    int count = 0;
-    for (int i = 0; i < board->width * board->height; i++)
+    piece_t* p = get_piece(board, from);
+    for (; *list != ATTACK_LIST_END; list++)
     {
-        piece_t* p = get_piece(board, i);
-        if (p->type == PIECE_TYPE_EMPTY || p->colour != colour)
+        if (get_piece(board, *list)->colour == p->colour)
             continue;
-        count += generate_moves(board, i, in_check, &moves[count], max_moves - count);
+        if (!add_move(moves, count, max_moves, from, *list, PIECE_TYPE_EMPTY, MOVE_FLAG_NONE))
+            return;
     }
-    *move_count = count;
-    return count > 0;
 }
 
 
-static bool would_move_cause_check(board_t* board, board_t* consider_board, move_t* m)
+static void generate_slider_moves(board_t* board, int from, direction_t first_dir, direction_t last_dir, move_t* moves, int* count, int max_moves)
 {
-    return !would_move_release_check(board, consider_board, m);
+    piece_t* p = get_piece(board, from);
+    for (int d = first_dir; d <= last_dir; d++)
+    {
+        for (const int* ray = attacks_ray(board->attacks, d, from); *ray != ATTACK_LIST_END; ray++)
+        {
+            piece_t* target = get_piece(board, *ray);
+            if (target->colour == p->colour)
+                break;
+            if (!add_move(moves, count, max_moves, from, *ray, PIECE_TYPE_EMPTY, MOVE_FLAG_NONE))
+                return;
+            if (target->type != PIECE_TYPE_EMPTY)
+                break;
+        }
+    }
 }
 
 
-bool has_legal_moves(board_t* board, colour_t colour)
+static void generate_castling_moves(board_t* board, int from, move_t* moves, int* count, int max_moves)
 {
-    board_t* consider_board = duplicate_board(board);
-    for (int from = 0; from < board->width * board->height; from++)
+    piece_t* king = get_piece(board, from);
+    colour_t enemy = other_colour(king->colour);
+    int from_x = index_to_x(board, from);
+    int y = index_to_y(board, from);
+    int back_rank = (king->colour == COLOUR_WHITE) ? 0 : board->height - 1;
+    if (y != back_rank || !(board->castling & ((king->colour == COLOUR_WHITE) ? CASTLE_WHITE : CASTLE_BLACK)))
+        return;
+    bool checked = false;
+    bool checked_known = false;
+    for (int step = -1; step <= 1; step += 2)
     {
-        piece_t* p = get_piece(board, from);
-        if (p->type == PIECE_TYPE_EMPTY || p->colour != colour)
+        int rook_x = (step > 0) ? board->width - 1 : 0;
+        if (!(board->castling & castle_right(king->colour, step > 0))
+            || !is_on_board(board, from_x + 2 * step, y)
+            || abs(rook_x - from_x) < 3)
+        {
+            continue;
+        }
+        piece_t* rook = get_piece(board, coords_to_index(board, rook_x, y));
+        if (rook->type != PIECE_TYPE_ROOK || rook->colour != king->colour)
             continue;
-        for (int to = 0; to < board->width * board->height; to++)
+        bool clear = true;
+        for (int x = from_x + step; x != rook_x && clear; x += step)
+            clear = get_piece(board, coords_to_index(board, x, y))->type == PIECE_TYPE_EMPTY;
+        if (!clear)
+            continue;
+        /* may not castle out of or through check, the landing square is
+         * covered by the usual legality test */
+        if (!checked_known)
         {
-            move_t m = { .from = from, .to = to, .promotion = PIECE_TYPE_EMPTY };
-            if (!is_move_legal(board, &m))
-                continue;
+            checked = is_square_attacked(board, from, enemy);
+            checked_known = true;
+        }
+        if (checked)
+            return;
+        if (is_square_attacked(board, coords_to_index(board, from_x + step, y), enemy))
+            continue;
+        if (!add_move(moves, count, max_moves, from, coords_to_index(board, from_x + 2 * step, y), PIECE_TYPE_EMPTY, MOVE_FLAG_CASTLING))
+            return;
+    }
+}
+
 
-            if (COLOUR_NONE == would_move_cause_check(board, consider_board, &m))
+int generate_pseudo_moves(board_t* board, unsigned index, move_t* moves, int max_moves)
+{
+    int count = 0;
+    piece_t* p = get_piece(board, index);
+    switch (p->type)
+    {
+        case PIECE_TYPE_PAWN:
+            generate_pawn_moves(board, index, moves, &count, max_moves);
+            break;
+        case PIECE_TYPE_KNIGHT:
+            generate_list_moves(board, index, attacks_knight(board->attacks, index), moves, &count, max_moves);
+            break;
+        case PIECE_TYPE_BISHOP:
+            generate_slider_moves(board, index, DIRECTION_NORTH_EAST, DIRECTION_SOUTH_EAST, moves, &count, max_moves);
+            break;
+        case PIECE_TYPE_ROOK:
+            generate_slider_moves(board, index, DIRECTION_EAST, DIRECTION_SOUTH, moves, &count, max_moves);
+            break;
+        case PIECE_TYPE_QUEEN:
+            generate_slider_moves(board, index, DIRECTION_EAST, DIRECTION_SOUTH_EAST, moves, &count, max_moves);
+            break;
+        case PIECE_TYPE_KING:
+            generate_list_moves(board, index, attacks_king(board->attacks, index), moves, &count, max_moves);
+            generate_castling_moves(board, index, moves, &count, max_moves);
+            break;
+        default:
+            break;
+    }
+    return count;
+}
+
+
+static void find_checks_and_pins(board_t* board, colour_t colour, legality_t* l)
+{
+    /* derived once per position, so single moves are judged without being
+     * played out */
+    colour_t enemy = other_colour(colour);
+    const attack_tables_t* t = board->attacks;
+    l->king = find_king(board, colour);
+    l->checkers = 0;
+    l->checker = -1;
+    l->check_slider = false;
+    l->pin_count = 0;
+    if (l->king < 0)
+        return;
+
+    const int* lists[] = { attacks_pawn(t, colour, l->king), attacks_knight(t, l->king) };
+    const piece_type_t types[] = { PIECE_TYPE_PAWN, PIECE_TYPE_KNIGHT };
+    for (unsigned i = 0; i < sizeof(lists) / sizeof(lists[0]); i++)
+    {
+        for (const int* sq = lists[i]; *sq != ATTACK_LIST_END; sq++)
+        {
+            if (is_piece(board, *sq, enemy, types[i]))
             {
-                destroy_board(consider_board);
-                return true;
+                l->checkers++;
+                l->checker = *sq;
+            }
+        }
+    }
+
+    for (int d = 0; d < ATTACK_DIRECTIONS; d++)
+    {
+        int blocker = ray_blocker(board, d, l->king);
+        if (blocker == ATTACK_LIST_END)
+            continue;
+        piece_t* p = get_piece(board, blocker);
+        if (p->colour == enemy)
+        {
+            if (is_slider_for(p->type, d))
+            {
+                l->checkers++;
+                l->checker = blocker;
+                l->check_slider = true;
             }
+            continue;
         }
+        int pinner = ray_blocker(board, d, blocker);
+        if (pinner == ATTACK_LIST_END)
+            continue;
+        p = get_piece(board, pinner);
+        if (p->colour == enemy && is_slider_for(p->type, d))
+            l->pinned[l->pin_count++] = blocker;
+    }
+}
+
+
+static bool is_aligned(board_t* board, int a, int b, int c)
+{
+    /* whether c lies on the line through a and b */
+    int ax = index_to_x(board, a);
+    int ay = index_to_y(board, a);
+    return (index_to_x(board, b) - ax) * (index_to_y(board, c) - ay)
+        == (index_to_y(board, b) - ay) * (index_to_x(board, c) - ax);
+}
+
+
+static bool is_between(board_t* board, int a, int b, int c)
+{
+    /* whether c lies strictly between a and b on their shared line */
+    if (!is_aligned(board, a, b, c))
+        return false;
+    int ax = index_to_x(board, a);
+    int ay = index_to_y(board, a);
+    int bx = index_to_x(board, b);
+    int by = index_to_y(board, b);
+    int cx = index_to_x(board, c);
+    int cy = index_to_y(board, c);
+    return (cx - ax) * (cx - bx) <= 0 && (cy - ay) * (cy - by) <= 0 && c != a && c != b;
+}
+
+
+static bool is_evasion_legal(board_t* board, const legality_t* l, move_t* m)
+{
+    for (int i = 0; i < l->pin_count; i++)
+    {
+        if (l->pinned[i] == m->from && !is_aligned(board, l->king, m->from, m->to))
+            return false;
+    }
+    if (!l->checkers)
+        return true;
+    if (l->checkers > 1)
+        return false;
+    return m->to == l->checker
+        || (l->check_slider && is_between(board, l->king, l->checker, m->to));
+}
+
+
+static int filter_king_moves(board_t* board, move_t* moves, int count)
+{
+    /* the king is lifted so sliders see through its square */
+    int king = moves[0].from;
+    piece_t p = *get_piece(board, king);
+    piece_t empty = { PIECE_TYPE_EMPTY, COLOUR_NONE };
+    colour_t enemy = other_colour(p.colour);
+    set_piece(board, king, &empty);
+    int legal = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!is_square_attacked(board, moves[i].to, enemy))
+            moves[legal++] = moves[i];
+    }
+    set_piece(board, king, &p);
+    return legal;
+}
+
+
+static int filter_legal_moves(board_t* board, const legality_t* l, move_t* moves, int count)
+{
+    /* moves all belong to one piece */
+    if (!count || l->king < 0)
+        return count;
+    if (moves[0].from == l->king)
+        return filter_king_moves(board, moves, count);
+    if (l->checkers > 1)
+        return 0;
+
+    int legal = 0;
+    for (int i = 0; i < count; i++)
+    {
+        /* en passant removes two pieces from a line, so is played out */
+        bool is_legal = (moves[i].flags == MOVE_FLAG_EN_PASSANT)
+            ? would_move_release_check(board, &moves[i])
+            : is_evasion_legal(board, l, &moves[i]);
+        if (is_legal)
+            moves[legal++] = moves[i];
+    }
+    return legal;
+}
+
+
+int generate_moves(board_t* board, unsigned index, move_t* moves, int max_moves)
+{
+    if (0 >= max_moves)
+        return 0;
+
+    legality_t l;
+    find_checks_and_pins(board, get_piece(board, index)->colour, &l);
+    int count = generate_pseudo_moves(board, index, moves, max_moves);
+    int legal = filter_legal_moves(board, &l, moves, count);
+    STATS_ADD(STAT_MOVES_GENERATED, legal);
+    return legal;
+}
+
+
+bool generate_all_moves(board_t* board, colour_t colour, move_list_t* list)
+{
+    legality_t l;
+    find_checks_and_pins(board, colour, &l);
+    int count = 0;
+    bool truncated = false;
+    for (int i = find_next_piece(board, colour, 0); i >= 0; i = find_next_piece(board, colour, i + 1))
+    {
+        /* a piece that filled the room left may have had more to give */
+        int room = MOVE_LIST_CAPACITY - count;
+        int piece_count = generate_pseudo_moves(board, i, &list->moves[count], room);
+        count += filter_legal_moves(board, &l, &list->moves[count], piece_count);
+        if (piece_count == room)
+        {
+            truncated = true;
+            break;
+        }
+    }
+    list->count = count;
+    list->truncated = truncated;
+    STATS_ADD(STAT_MOVES_GENERATED, count);
+    return count > 0;
+}
+
+
+bool resolve_move(board_t* board, move_t* m)
+{
+    /* matches a move read from outside, such as UCI, against the legal
+     * moves so it picks up the generator's flags */
+    int max_moves = max_piece_moves(board);
+    move_t moves[max_moves];
+    int count = generate_moves(board, m->from, moves, max_moves);
+    for (int i = 0; i < count; i++)
+    {
+        if (move_equal(&moves[i], m))
+        {
+            *m = moves[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool has_legal_moves(board_t* board, colour_t colour)
+{
+    /* one square's worth of pseudo-legal moves at a time, stopping at the
+     * first piece with a legal move */
+    int max_moves = max_piece_moves(board);
+    move_t moves[max_moves];
+    legality_t l;
+    find_checks_and_pins(board, colour, &l);
+    for (int from = find_next_piece(board, colour, 0); from >= 0; from = find_next_piece(board, colour, from + 1))
+    {
+        int count = generate_pseudo_moves(board, from, moves, max_moves);
+        if (filter_legal_moves(board, &l, moves, count))
+            return true;
     }
-    destroy_board(consider_board);
     return false;
 }
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "stats.h"
+#include "util.h"
+
+
+/* relaxed atomics, the counts only need to add up, not order anything */
+static _Atomic uint64_t counters[STAT_COUNT];
+static _Atomic uint64_t phase_calls[PHASE_COUNT];
+static _Atomic uint64_t phase_us[PHASE_COUNT];
+
+static const char* const counter_names[STAT_COUNT] =
+{
+    [STAT_IS_MOVE_LEGAL] = "is_move_legal",
+    [STAT_IS_SQUARE_ATTACKED] = "is_square_attacked",
+    [STAT_BOARD_COPIES] = "board_copies",
+    [STAT_MOVES_GENERATED] = "moves_generated",
+    [STAT_MOVES_MADE] = "moves_made",
+    [STAT_NODES] = "nodes",
+    [STAT_EVALUATIONS] = "evaluations",
+    [STAT_MOVES_SCORED] = "moves_scored",
+};
+
+static const char* const phase_names[PHASE_COUNT] =
+{
+    [PHASE_STATUS] = "status",
+    [PHASE_APPLY_MOVE] = "apply_move",
+    [PHASE_BEST_MOVE] = "best_move",
+    [PHASE_BOOK] = "book",
+    [PHASE_TABLEBASE] = "tablebase",
+    [PHASE_GENERATOR] = "generator",
+    [PHASE_PERFT] = "perft",
+};
+
+
+void stats_add(stat_counter_t counter, uint64_t n)
+{
+    atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+}
+
+
+void stats_add_time(stat_phase_t phase, uint64_t start_us)
+{
+    atomic_fetch_add_explicit(&phase_calls[phase], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&phase_us[phase], monotonic_us() - start_us, memory_order_relaxed);
+}
+
+
+void stats_reset(void)
+{
+    for (int i = 0; i < STAT_COUNT; i++)
+        atomic_store_explicit(&counters[i], 0, memory_order_relaxed);
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+        atomic_store_explicit(&phase_calls[i], 0, memory_order_relaxed);
+        atomic_store_explicit(&phase_us[i], 0, memory_order_relaxed);
+    }
+}
+
+
+uint64_t stats_counter(stat_counter_t counter)
+{
+    return atomic_load_explicit(&counters[counter], memory_order_relaxed);
+}
+
+
+uint64_t stats_phase_calls(stat_phase_t phase)
+{
+    return atomic_load_explicit(&phase_calls[phase], memory_order_relaxed);
+}
+
+
+uint64_t stats_phase_us(stat_phase_t phase)
+{
+    return atomic_load_explicit(&phase_us[phase], memory_order_relaxed);
+}
+
+
+int stats_to_json(char* out, int max_len)
+{
+    /* {"enabled":true,"counters":{"nodes":1,...},
+     *  "phases":{"status":{"calls":1,"us":2},...}}
+     * returns the length, or -1 if it doesn't fit */
+    if (max_len <= 0)
+        return -1;
+    int pos = snprintf(out, max_len, "{\"enabled\":%s,\"counters\":{", STATS_ENABLED ? "true" : "false");
+    for (int i = 0; i < STAT_COUNT && pos < max_len; i++)
+    {
+        pos += snprintf(out + pos, max_len - pos, "%s\"%s\":%llu", i ? "," : "",
+            counter_names[i], (unsigned long long)stats_counter(i));
+    }
+    if (pos < max_len)
+        pos += snprintf(out + pos, max_len - pos, "},\"phases\":{");
+    for (int i = 0; i < PHASE_COUNT && pos < max_len; i++)
+    {
+        pos += snprintf(out + pos, max_len - pos, "%s\"%s\":{\"calls\":%llu,\"us\":%llu}", i ? "," : "",
+            phase_names[i], (unsigned long long)stats_phase_calls(i), (unsigned long long)stats_phase_us(i));
+    }
+    if (pos < max_len)
+        pos += snprintf(out + pos, max_len - pos, "}}");
+    return pos < max_len ? pos : -1;
+}
@@ -0,0 +1,617 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef __TO_WEBASM__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "bitboard.h"
+#include "rules.h"
+#include "tb.h"
+
+
+#define TB_SQUARES              (TB_BOARD_SIZE * TB_BOARD_SIZE)
+#define TB_PAWNLESS_SLOTS       10
+#define TB_PAWN_SLOTS           32
+#define TB_PATH_LEN             1024
+#define TB_SCORE_MATE           1000
+
+
+typedef enum
+{
+    TB_STORAGE_MAPPED,
+    TB_STORAGE_OWNED
+} tb_storage_t;
+
+typedef struct
+{
+    char signature[TB_SIGNATURE_LEN];
+    int pieces;
+    const unsigned char* data;
+    size_t size;
+    tb_storage_t storage;
+} tb_table_t;
+
+
+static tb_table_t tables[TB_MAX_TABLES];
+static int table_count = 0;
+
+static const char piece_chars[PIECE_TYPE_COUNT] = { ' ', 'P', 'N', 'B', 'R', 'Q', 'K' };
+
+/* without pawns the white king is folded into the a8-d8-d5 triangle */
+static const signed char pawnless_slots[TB_SQUARES] =
+{
+     0,  1,  2,  3, -1, -1, -1, -1,
+    -1,  4,  5,  6, -1, -1, -1, -1,
+    -1, -1,  7,  8, -1, -1, -1, -1,
+    -1, -1, -1,  9, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1,
+};
+static const int pawnless_squares[TB_PAWNLESS_SLOTS] = { 0, 1, 2, 3, 9, 10, 11, 18, 19, 27 };
+
+
+static colour_t opponent(colour_t colour)
+{
+    return (colour == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+}
+
+
+static piece_type_t type_from_char(char c)
+{
+    for (int t = PIECE_TYPE_PAWN; t < PIECE_TYPE_COUNT; t++)
+    {
+        if (piece_chars[t] == c)
+            return (piece_type_t)t;
+    }
+    return PIECE_TYPE_EMPTY;
+}
+
+
+static int king_slot(int sq, bool pawns)
+{
+    /* pawns only allow the left-right mirror, so the king keeps to a-d */
+    int row = sq / TB_BOARD_SIZE;
+    int col = sq % TB_BOARD_SIZE;
+    if (pawns)
+        return (col < TB_BOARD_SIZE / 2) ? row * (TB_BOARD_SIZE / 2) + col : -1;
+    return pawnless_slots[sq];
+}
+
+
+static int slot_square(int slot, bool pawns)
+{
+    if (pawns)
+        return (slot / (TB_BOARD_SIZE / 2)) * TB_BOARD_SIZE + slot % (TB_BOARD_SIZE / 2);
+    return pawnless_squares[slot];
+}
+
+
+static int transform_square(int t, int sq)
+{
+    /* bit 2 transposes, bit 0 mirrors files, bit 1 mirrors ranks */
+    int row = sq / TB_BOARD_SIZE;
+    int col = sq % TB_BOARD_SIZE;
+    if (t & 4)
+    {
+        int tmp = row;
+        row = col;
+        col = tmp;
+    }
+    if (t & 1)
+        col = TB_BOARD_SIZE - 1 - col;
+    if (t & 2)
+        row = TB_BOARD_SIZE - 1 - row;
+    return row * TB_BOARD_SIZE + col;
+}
+
+
+static bool same_piece(const piece_t* a, const piece_t* b)
+{
+    return a->type == b->type && a->colour == b->colour;
+}
+
+
+static int compare_sides(const piece_t* white, int white_count, const piece_t* black, int black_count)
+{
+    /* more pieces is stronger, then the better piece first */
+    if (white_count != black_count)
+        return white_count - black_count;
+    for (int i = 0; i < white_count; i++)
+    {
+        if (white[i].type != black[i].type)
+            return (int)white[i].type - (int)black[i].type;
+    }
+    return 0;
+}
+
+
+static int collect_side(const tb_position_t* pos, colour_t colour, piece_t* pieces, int* squares)
+{
+    /* a side's pieces other than the king, best first */
+    int count = 0;
+    for (int i = 0; i < pos->count; i++)
+    {
+        if (pos->pieces[i].colour != colour || pos->pieces[i].type == PIECE_TYPE_KING)
+            continue;
+        int j = count++;
+        while (j > 0 && pieces[j - 1].type < pos->pieces[i].type)
+        {
+            pieces[j] = pieces[j - 1];
+            squares[j] = squares[j - 1];
+            j--;
+        }
+        pieces[j] = pos->pieces[i];
+        squares[j] = pos->squares[i];
+    }
+    return count;
+}
+
+
+bool tb_normalise(const tb_position_t* pos, tb_position_t* out)
+{
+    /* orders the pieces white king, black king, white's then black's best
+     * first, and swaps colours if black is the stronger side */
+    if (pos->count < 2 || pos->count > TB_MAX_PIECES)
+        return false;
+    int kings[COLOUR_COUNT] = { -1, -1, -1 };
+    for (int i = 0; i < pos->count; i++)
+    {
+        const piece_t* p = &pos->pieces[i];
+        if (p->type != PIECE_TYPE_KING)
+            continue;
+        if (kings[p->colour] >= 0)
+            return false;
+        kings[p->colour] = pos->squares[i];
+    }
+    if (kings[COLOUR_WHITE] < 0 || kings[COLOUR_BLACK] < 0)
+        return false;
+
+    piece_t white[TB_MAX_PIECES], black[TB_MAX_PIECES];
+    int white_sq[TB_MAX_PIECES], black_sq[TB_MAX_PIECES];
+    int white_count = collect_side(pos, COLOUR_WHITE, white, white_sq);
+    int black_count = collect_side(pos, COLOUR_BLACK, black, black_sq);
+    bool flip = compare_sides(white, white_count, black, black_count) < 0;
+
+    out->count = pos->count;
+    out->turn = flip ? opponent(pos->turn) : pos->turn;
+    int n = 0;
+    out->pieces[n] = (piece_t){ PIECE_TYPE_KING, COLOUR_WHITE };
+    out->squares[n++] = kings[flip ? COLOUR_BLACK : COLOUR_WHITE];
+    out->pieces[n] = (piece_t){ PIECE_TYPE_KING, COLOUR_BLACK };
+    out->squares[n++] = kings[flip ? COLOUR_WHITE : COLOUR_BLACK];
+    const piece_t* first = flip ? black : white;
+    const int* first_sq = flip ? black_sq : white_sq;
+    int first_count = flip ? black_count : white_count;
+    for (int i = 0; i < first_count; i++, n++)
+    {
+        out->pieces[n] = (piece_t){ first[i].type, COLOUR_WHITE };
+        out->squares[n] = first_sq[i];
+    }
+    const piece_t* second = flip ? white : black;
+    const int* second_sq = flip ? white_sq : black_sq;
+    int second_count = flip ? white_count : black_count;
+    for (int i = 0; i < second_count; i++, n++)
+    {
+        out->pieces[n] = (piece_t){ second[i].type, COLOUR_BLACK };
+        out->squares[n] = second_sq[i];
+    }
+    if (flip)
+    {
+        for (int i = 0; i < n; i++)
+            out->squares[i] = transform_square(2, out->squares[i]);
+    }
+    return true;
+}
+
+
+void tb_signature(const tb_position_t* normalised, char* out)
+{
+    int n = 0;
+    out[n++] = 'K';
+    for (int i = 2; i < normalised->count; i++)
+    {
+        if (normalised->pieces[i].colour == COLOUR_WHITE)
+            out[n++] = piece_chars[normalised->pieces[i].type];
+    }
+    out[n++] = 'K';
+    for (int i = 2; i < normalised->count; i++)
+    {
+        if (normalised->pieces[i].colour == COLOUR_BLACK)
+            out[n++] = piece_chars[normalised->pieces[i].type];
+    }
+    out[n] = '\0';
+}
+
+
+static bool parse_signature(const char* signature, tb_position_t* pos)
+{
+    /* pieces in normalised order, each on its own square */
+    size_t len = strlen(signature);
+    if (len < 2 || len > TB_MAX_PIECES || signature[0] != 'K')
+        return false;
+    const char* black = strchr(signature + 1, 'K');
+    if (!black || strchr(black + 1, 'K'))
+        return false;
+    pos->count = 0;
+    pos->turn = COLOUR_WHITE;
+    pos->pieces[pos->count++] = (piece_t){ PIECE_TYPE_KING, COLOUR_WHITE };
+    pos->pieces[pos->count++] = (piece_t){ PIECE_TYPE_KING, COLOUR_BLACK };
+    for (size_t i = 1; i < len; i++)
+    {
+        if (signature + i == black)
+            continue;
+        piece_type_t type = type_from_char(signature[i]);
+        if (type == PIECE_TYPE_EMPTY)
+            return false;
+        colour_t colour = (signature + i < black) ? COLOUR_WHITE : COLOUR_BLACK;
+        pos->pieces[pos->count++] = (piece_t){ type, colour };
+    }
+    for (int i = 0; i < pos->count; i++)
+        pos->squares[i] = i;
+    return true;
+}
+
+
+bool tb_normalise_signature(const char* signature, char* out)
+{
+    tb_position_t pos, normalised;
+    if (!parse_signature(signature, &pos) || !tb_normalise(&pos, &normalised))
+        return false;
+    tb_signature(&normalised, out);
+    return true;
+}
+
+
+bool tb_has_pawns(const char* signature)
+{
+    return strchr(signature, 'P') != NULL;
+}
+
+
+uint64_t tb_table_positions(const char* signature)
+{
+    uint64_t positions = 2 * (tb_has_pawns(signature) ? TB_PAWN_SLOTS : TB_PAWNLESS_SLOTS);
+    for (size_t i = 1; i < strlen(signature); i++)
+        positions *= TB_SQUARES;
+    return positions;
+}
+
+
+static uint64_t transformed_index(const tb_position_t* pos, int t, bool pawns)
+{
+    int squares[TB_MAX_PIECES];
+    for (int i = 0; i < pos->count; i++)
+        squares[i] = transform_square(t, pos->squares[i]);
+    int slot = king_slot(squares[0], pawns);
+    if (slot < 0)
+        return UINT64_MAX;
+
+    /* identical pieces are interchangeable, keep them in square order */
+    for (int i = 3; i < pos->count; i++)
+    {
+        for (int j = i; j > 2 && same_piece(&pos->pieces[j - 1], &pos->pieces[j]) && squares[j - 1] > squares[j]; j--)
+        {
+            int tmp = squares[j];
+            squares[j] = squares[j - 1];
+            squares[j - 1] = tmp;
+        }
+    }
+
+    uint64_t index = (pos->turn == COLOUR_BLACK) ? 1 : 0;
+    index = index * (pawns ? TB_PAWN_SLOTS : TB_PAWNLESS_SLOTS) + (uint64_t)slot;
+    for (int i = 1; i < pos->count; i++)
+        index = index * TB_SQUARES + (uint64_t)squares[i];
+    return index;
+}
+
+
+uint64_t tb_index(const tb_position_t* normalised)
+{
+    /* the smallest index over the symmetries that fold the white king, so
+     * every position has exactly one */
+    bool pawns = false;
+    for (int i = 2; i < normalised->count; i++)
+        pawns |= normalised->pieces[i].type == PIECE_TYPE_PAWN;
+    int transforms = pawns ? 2 : 8;
+    uint64_t best = UINT64_MAX;
+    for (int t = 0; t < transforms; t++)
+    {
+        uint64_t index = transformed_index(normalised, t, pawns);
+        if (index < best)
+            best = index;
+    }
+    return best;
+}
+
+
+bool tb_decode(const char* signature, uint64_t index, tb_position_t* out)
+{
+    /* false if the index puts two pieces on one square */
+    if (!parse_signature(signature, out))
+        return false;
+    bool pawns = tb_has_pawns(signature);
+    for (int i = out->count - 1; i > 0; i--)
+    {
+        out->squares[i] = (int)(index % TB_SQUARES);
+        index /= TB_SQUARES;
+    }
+    int slots = pawns ? TB_PAWN_SLOTS : TB_PAWNLESS_SLOTS;
+    out->squares[0] = slot_square((int)(index % slots), pawns);
+    index /= slots;
+    if (index > 1)
+        return false;
+    out->turn = index ? COLOUR_BLACK : COLOUR_WHITE;
+    for (int i = 0; i < out->count; i++)
+    {
+        for (int j = 0; j < i; j++)
+        {
+            if (out->squares[i] == out->squares[j])
+                return false;
+        }
+    }
+    return true;
+}
+
+
+static tb_table_t* find_table(const char* signature)
+{
+    for (int i = 0; i < table_count; i++)
+    {
+        if (!strcmp(tables[i].signature, signature))
+            return &tables[i];
+    }
+    return NULL;
+}
+
+
+static bool attach(const unsigned char* data, size_t size, tb_storage_t storage)
+{
+    /* checks the header and that the size matches the signature */
+    char signature[TB_SIGNATURE_LEN];
+    char normalised[TB_SIGNATURE_LEN];
+    if (size < TB_HEADER_SIZE || memcmp(data, TB_MAGIC, strlen(TB_MAGIC)))
+    {
+        printf("not an endgame table\n");
+        return false;
+    }
+    memcpy(signature, data + strlen(TB_MAGIC), TB_SIGNATURE_LEN);
+    signature[TB_SIGNATURE_LEN - 1] = '\0';
+    if (!tb_normalise_signature(signature, normalised) || strcmp(signature, normalised))
+    {
+        printf("bad endgame table signature '%s'\n", signature);
+        return false;
+    }
+    if (size != TB_HEADER_SIZE + tb_table_positions(signature))
+    {
+        printf("endgame table %s has the wrong size\n", signature);
+        return false;
+    }
+    if (find_table(signature) || table_count >= TB_MAX_TABLES)
+    {
+        printf("endgame table %s not added\n", signature);
+        return false;
+    }
+    tb_table_t* table = &tables[table_count++];
+    strcpy(table->signature, signature);
+    table->pieces = (int)strlen(signature);
+    table->data = data;
+    table->size = size;
+    table->storage = storage;
+    return true;
+}
+
+
+#ifndef __TO_WEBASM__
+bool tb_load(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("could not open endgame table '%s'\n", path);
+        return false;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        printf("could not map endgame table '%s'\n", path);
+        return false;
+    }
+    if (!attach(data, (size_t)st.st_size, TB_STORAGE_MAPPED))
+    {
+        munmap(data, (size_t)st.st_size);
+        return false;
+    }
+    return true;
+}
+
+
+int tb_open(const char* dir)
+{
+    /* loads every .tb file in the directory, returns how many */
+    DIR* d = opendir(dir);
+    if (!d)
+    {
+        printf("could not open endgame table directory '%s'\n", dir);
+        return 0;
+    }
+    int loaded = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)))
+    {
+        size_t len = strlen(entry->d_name);
+        if (len < 3 || strcmp(entry->d_name + len - 3, ".tb"))
+            continue;
+        char path[TB_PATH_LEN];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (tb_load(path))
+            loaded++;
+    }
+    closedir(d);
+    return loaded;
+}
+#else
+bool tb_load(const char* path)
+{
+    /* the page fetches tables itself and hands them over with tb_adopt */
+    printf("no endgame table files in the browser: '%s'\n", path);
+    return false;
+}
+
+
+int tb_open(const char* dir)
+{
+    printf("no endgame table files in the browser: '%s'\n", dir);
+    return 0;
+}
+#endif
+
+
+bool tb_adopt(void* data, size_t size)
+{
+    /* takes ownership of a malloc'd copy of a file, freed on close */
+    if (!attach(data, size, TB_STORAGE_OWNED))
+    {
+        free(data);
+        return false;
+    }
+    return true;
+}
+
+
+void tb_close(void)
+{
+    for (int i = 0; i < table_count; i++)
+    {
+#ifndef __TO_WEBASM__
+        if (tables[i].storage == TB_STORAGE_MAPPED)
+            munmap((void*)tables[i].data, tables[i].size);
+#endif
+        if (tables[i].storage == TB_STORAGE_OWNED)
+            free((void*)tables[i].data);
+    }
+    table_count = 0;
+}
+
+
+int tb_max_pieces(void)
+{
+    int pieces = 0;
+    for (int i = 0; i < table_count; i++)
+    {
+        if (tables[i].pieces > pieces)
+            pieces = tables[i].pieces;
+    }
+    return pieces;
+}
+
+
+bool tb_probe_position(const tb_position_t* pos, tb_result_t* result)
+{
+    /* false if no loaded table covers the position */
+    tb_position_t normalised;
+    if (!tb_normalise(pos, &normalised))
+        return false;
+    if (normalised.count == 2)
+    {
+        result->wdl = TB_DRAW;
+        result->dtm = 0;
+        return true;
+    }
+    char signature[TB_SIGNATURE_LEN];
+    tb_signature(&normalised, signature);
+    const tb_table_t* table = find_table(signature);
+    if (!table)
+        return false;
+    unsigned cell = table->data[TB_HEADER_SIZE + tb_index(&normalised)];
+    result->wdl = (tb_wdl_t)(cell & TB_CELL_WDL_MASK);
+    result->dtm = (int)(cell >> TB_CELL_DTM_SHIFT);
+    return result->wdl != TB_ILLEGAL;
+}
+
+
+static bool position_from_board(const board_t* board, colour_t turn, tb_position_t* pos)
+{
+    if (board->width != TB_BOARD_SIZE || board->height != TB_BOARD_SIZE || !board->has_bitboards)
+        return false;
+    bitboard_t occupied = board->occupied[COLOUR_WHITE] | board->occupied[COLOUR_BLACK];
+    if (bitboard_count(occupied) > TB_MAX_PIECES)
+        return false;
+    pos->count = 0;
+    pos->turn = turn;
+    while (occupied)
+    {
+        int sq = bitboard_pop_lsb(&occupied);
+        pos->pieces[pos->count] = board->squares[sq];
+        pos->squares[pos->count++] = sq;
+    }
+    return true;
+}
+
+
+bool tb_probe(const board_t* board, colour_t turn, tb_result_t* result)
+{
+    tb_position_t pos;
+    return table_count && position_from_board(board, turn, &pos) && tb_probe_position(&pos, result);
+}
+
+
+static int result_score(const tb_result_t* result)
+{
+    /* from the point of view of the side to move: quick wins, slow losses */
+    if (result->wdl == TB_WIN)
+        return TB_SCORE_MATE - result->dtm;
+    if (result->wdl == TB_LOSS)
+        return -TB_SCORE_MATE + result->dtm;
+    return 0;
+}
+
+
+bool tb_best_move(board_t* board, colour_t turn, const move_list_t* legal_moves, move_t* move)
+{
+    /* the tables assume no castling or en passant, so positions that have
+     * either are left to the generator */
+    tb_result_t result;
+    if (!legal_moves->count || board->castling || board->en_passant >= 0
+        || !tb_probe(board, turn, &result))
+    {
+        return false;
+    }
+
+    int best = -1;
+    int best_score = 0;
+    for (int i = 0; i < legal_moves->count; i++)
+    {
+        undo_t undo;
+        make_move(board, &legal_moves->moves[i], &undo);
+        tb_result_t child;
+        bool found = tb_probe(board, opponent(turn), &child);
+        unmake_move(board, &undo);
+        if (!found)
+            return false;
+        int score = -result_score(&child);
+        if (best < 0 || score > best_score)
+        {
+            best = i;
+            best_score = score;
+        }
+    }
+    *move = legal_moves->moves[best];
+    return true;
+}
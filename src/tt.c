@@ -0,0 +1,245 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tt.h"
+
+
+/* entry data layout, packed into one 64-bit word next to the key */
+#define TT_MOVE_SHIFT           0
+#define TT_SCORE_SHIFT          32
+#define TT_DEPTH_SHIFT          48
+#define TT_BOUND_SHIFT          56
+#define TT_AGE_SHIFT            58
+
+#define TT_MOVE_MASK            0xffffffffull
+#define TT_SCORE_MASK           0xffffull
+#define TT_DEPTH_MASK           0xffull
+#define TT_BOUND_MASK           0x3ull
+#define TT_AGE_MASK             0x3full
+
+#define TT_MAX_DEPTH            ((int)TT_DEPTH_MASK)
+
+
+/* shared by search threads without locks: the key is stored xor'd with the
+ * data, so a torn write from two racing stores fails the key check instead
+ * of returning another position's data */
+typedef struct
+{
+    _Atomic uint64_t key;
+    _Atomic uint64_t data;
+} tt_entry_t;
+
+typedef struct
+{
+    tt_entry_t entries[TT_BUCKET_ENTRIES];
+} tt_bucket_t;
+
+
+static tt_bucket_t* buckets = NULL;
+static uint64_t bucket_count = 0;
+static unsigned table_size_mb = 0;
+static bool configured = false;
+static _Atomic unsigned age = 0;     /* bumped by concurrent searches */
+static _Atomic uint64_t used = 0;
+static _Atomic uint64_t hits = 0;
+static _Atomic uint64_t misses = 0;
+static _Atomic uint64_t stores = 0;
+
+
+void tt_clear(void)
+{
+    /* not to be called while a search is running */
+    if (buckets)
+        memset(buckets, 0, bucket_count * sizeof(tt_bucket_t));
+    atomic_store(&used, 0);
+    atomic_store(&hits, 0);
+    atomic_store(&misses, 0);
+    atomic_store(&stores, 0);
+}
+
+
+bool tt_resize(unsigned size_mb)
+{
+    /* a size of zero turns the table off */
+    free(buckets);
+    buckets = NULL;
+    bucket_count = 0;
+    table_size_mb = 0;
+    configured = true;
+    tt_clear();
+    if (!size_mb)
+        return true;
+
+    uint64_t budget = (uint64_t)size_mb * 1024 * 1024 / sizeof(tt_bucket_t);
+    uint64_t count = 1;
+    while (count * 2 <= budget)
+        count *= 2;
+    buckets = calloc(count, sizeof(tt_bucket_t));
+    if (!buckets)
+        return false;
+    bucket_count = count;
+    table_size_mb = size_mb;
+    return true;
+}
+
+
+void tt_init(void)
+{
+    /* the table is otherwise made on first use, which is unlocked, so
+     * callers that search from several threads call this before starting
+     * them; a size already chosen is kept */
+    if (!configured)
+        tt_resize(TT_DEFAULT_SIZE_MB);
+}
+
+
+static bool ensure_table(void)
+{
+    tt_init();
+    return buckets != NULL;
+}
+
+
+static unsigned current_age(void)
+{
+    return atomic_load_explicit(&age, memory_order_relaxed) & TT_AGE_MASK;
+}
+
+
+void tt_new_search(void)
+{
+    atomic_fetch_add_explicit(&age, 1, memory_order_relaxed);
+}
+
+
+static tt_bound_t data_bound(uint64_t data)
+{
+    return (tt_bound_t)((data >> TT_BOUND_SHIFT) & TT_BOUND_MASK);
+}
+
+
+static int data_depth(uint64_t data)
+{
+    return (int)((data >> TT_DEPTH_SHIFT) & TT_DEPTH_MASK);
+}
+
+
+static unsigned data_age(uint64_t data)
+{
+    return (unsigned)((data >> TT_AGE_SHIFT) & TT_AGE_MASK);
+}
+
+
+static uint64_t load_relaxed(_Atomic uint64_t* word)
+{
+    return atomic_load_explicit(word, memory_order_relaxed);
+}
+
+
+static void bump(_Atomic uint64_t* counter)
+{
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
+
+
+static tt_bucket_t* bucket_for(uint64_t key)
+{
+    return &buckets[key & (bucket_count - 1)];
+}
+
+
+bool tt_probe(uint64_t key, tt_result_t* result)
+{
+    if (!ensure_table())
+        return false;
+    tt_bucket_t* bucket = bucket_for(key);
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++)
+    {
+        tt_entry_t* e = &bucket->entries[i];
+        uint64_t data = load_relaxed(&e->data);
+        if ((load_relaxed(&e->key) ^ data) != key || data_bound(data) == TT_BOUND_NONE)
+            continue;
+        result->bound = data_bound(data);
+        result->depth = data_depth(data);
+        result->score = (int16_t)((data >> TT_SCORE_SHIFT) & TT_SCORE_MASK);
+        result->move = move_unpack((uint32_t)((data >> TT_MOVE_SHIFT) & TT_MOVE_MASK));
+        bump(&hits);
+        return true;
+    }
+    bump(&misses);
+    return false;
+}
+
+
+static int replacement_worth(uint64_t data)
+{
+    /* lower is replaced first: empty slots, then stale searches, then
+     * the shallowest entries */
+    if (data_bound(data) == TT_BOUND_NONE)
+        return -1;
+    int worth = data_depth(data);
+    if (data_age(data) == current_age())
+        worth += TT_MAX_DEPTH + 1;
+    return worth;
+}
+
+
+void tt_store(uint64_t key, int depth, int score, tt_bound_t bound, const move_t* move)
+{
+    if (!ensure_table())
+        return;
+    if (depth < 0)
+        depth = 0;
+    if (depth > TT_MAX_DEPTH)
+        depth = TT_MAX_DEPTH;
+
+    tt_bucket_t* bucket = bucket_for(key);
+    tt_entry_t* victim = &bucket->entries[0];
+    uint64_t victim_data = load_relaxed(&victim->data);
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++)
+    {
+        tt_entry_t* e = &bucket->entries[i];
+        uint64_t old = load_relaxed(&e->data);
+        if ((load_relaxed(&e->key) ^ old) == key && data_bound(old) != TT_BOUND_NONE)
+        {
+            /* keep a deeper result for the same position unless it is stale
+             * or the new one is exact */
+            if (depth < data_depth(old) && bound != TT_BOUND_EXACT && data_age(old) == current_age())
+                return;
+            victim = e;
+            victim_data = old;
+            break;
+        }
+        if (replacement_worth(old) < replacement_worth(victim_data))
+        {
+            victim = e;
+            victim_data = old;
+        }
+    }
+
+    move_t none = move_encode(-1, -1, PIECE_TYPE_EMPTY, MOVE_FLAG_NONE);
+    uint64_t data = ((uint64_t)move_pack(move ? move : &none) << TT_MOVE_SHIFT)
+        | ((uint64_t)(uint16_t)score << TT_SCORE_SHIFT)
+        | ((uint64_t)depth << TT_DEPTH_SHIFT)
+        | ((uint64_t)bound << TT_BOUND_SHIFT)
+        | ((uint64_t)current_age() << TT_AGE_SHIFT);
+    if (data_bound(victim_data) == TT_BOUND_NONE)
+        bump(&used);
+    atomic_store_explicit(&victim->key, key ^ data, memory_order_relaxed);
+    atomic_store_explicit(&victim->data, data, memory_order_relaxed);
+    bump(&stores);
+}
+
+
+void tt_get_stats(tt_stats_t* stats)
+{
+    stats->size_mb = table_size_mb;
+    stats->entries = bucket_count * TT_BUCKET_ENTRIES;
+    stats->used = atomic_load(&used);
+    stats->hits = atomic_load(&hits);
+    stats->misses = atomic_load(&misses);
+    stats->stores = atomic_load(&stores);
+}
@@ -1,8 +1,20 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#include "util.h"
+
+
+#define RANDOM_INCREMENT        0x9e3779b97f4a7c15ull
+
+
+static _Atomic uint64_t seeds_given = 0;
 
 
 void raise_error(int err, const char* fmt, ...)
@@ -18,3 +30,30 @@ void raise_error(int err, const char* fmt, ...)
     exit(err ? err : 1);
 }
 
+
+uint64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+
+uint64_t random_next(uint64_t* state)
+{
+    /* splitmix64, each caller keeps its own state so threads never share */
+    uint64_t x = (*state += RANDOM_INCREMENT);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+
+uint64_t random_seed(void)
+{
+    /* from the clock, and different for every call even within the same
+     * microsecond; never 0, which asks for a seed */
+    uint64_t state = monotonic_us() ^ (atomic_fetch_add(&seeds_given, 1) * RANDOM_INCREMENT);
+    uint64_t seed = random_next(&state);
+    return seed ? seed : RANDOM_INCREMENT;
+}
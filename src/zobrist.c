@@ -0,0 +1,110 @@
+#include <pthread.h>
+#include <stdint.h>
+
+#include "zobrist.h"
+
+
+/* squares past the table are keyed by mixing their index on the fly */
+#define ZOBRIST_TABLE_SQUARES   256
+#define ZOBRIST_SEED            0x9e3779b97f4a7c15ull
+#define CASTLING_KEY_COUNT      (CASTLE_ALL + 1)
+/* seeds past every piece key's, so no two keys share one */
+#define CASTLING_KEY_SEED       ((uint64_t)1 << 32)
+#define EN_PASSANT_KEY_SEED     ((uint64_t)2 << 32)
+
+
+static uint64_t piece_keys[COLOUR_COUNT][PIECE_TYPE_COUNT][ZOBRIST_TABLE_SQUARES];
+static uint64_t castling_keys[CASTLING_KEY_COUNT];
+static uint64_t en_passant_keys[ZOBRIST_TABLE_SQUARES];
+static uint64_t side_key;
+static pthread_once_t keys_once = PTHREAD_ONCE_INIT;
+
+
+static uint64_t splitmix64(uint64_t x)
+{
+    x += ZOBRIST_SEED;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+
+static uint64_t piece_key_seed(colour_t colour, piece_type_t type, int sq)
+{
+    return ((uint64_t)sq * PIECE_TYPE_COUNT + type) * COLOUR_COUNT + colour + 1;
+}
+
+
+static void build_keys(void)
+{
+    /* keys are derived from a fixed seed so every build hashes alike */
+    for (int c = COLOUR_WHITE; c < COLOUR_COUNT; c++)
+    {
+        for (int t = PIECE_TYPE_PAWN; t < PIECE_TYPE_COUNT; t++)
+        {
+            for (int sq = 0; sq < ZOBRIST_TABLE_SQUARES; sq++)
+                piece_keys[c][t][sq] = splitmix64(piece_key_seed(c, t, sq));
+        }
+    }
+    /* no rights and no en passant square key to 0, so boards without them
+     * hash the same as the pieces alone */
+    castling_keys[0] = 0;
+    for (int r = 1; r < CASTLING_KEY_COUNT; r++)
+        castling_keys[r] = splitmix64(CASTLING_KEY_SEED + r);
+    for (int sq = 0; sq < ZOBRIST_TABLE_SQUARES; sq++)
+        en_passant_keys[sq] = splitmix64(EN_PASSANT_KEY_SEED + sq);
+    side_key = splitmix64(0);
+}
+
+
+void zobrist_init(void)
+{
+    /* boards may be created from several threads at once */
+    pthread_once(&keys_once, build_keys);
+}
+
+
+uint64_t zobrist_piece(colour_t colour, piece_type_t type, int sq)
+{
+    if (type == PIECE_TYPE_EMPTY)
+        return 0;
+    if (sq < ZOBRIST_TABLE_SQUARES)
+        return piece_keys[colour][type][sq];
+    return splitmix64(piece_key_seed(colour, type, sq));
+}
+
+
+uint64_t zobrist_castling(unsigned rights)
+{
+    return castling_keys[rights & CASTLE_ALL];
+}
+
+
+uint64_t zobrist_en_passant(int sq)
+{
+    if (sq < 0)
+        return 0;
+    if (sq < ZOBRIST_TABLE_SQUARES)
+        return en_passant_keys[sq];
+    return splitmix64(EN_PASSANT_KEY_SEED + sq);
+}
+
+
+uint64_t zobrist_side(void)
+{
+    return side_key;
+}
+
+
+uint64_t zobrist_hash(const board_t* b, colour_t turn)
+{
+    uint64_t hash = (turn == COLOUR_BLACK) ? side_key : 0;
+    hash ^= zobrist_castling(b->castling) ^ zobrist_en_passant(b->en_passant);
+    int size = b->width * b->height;
+    for (int i = 0; i < size; i++)
+    {
+        piece_t* p = get_piece(b, i);
+        hash ^= zobrist_piece(p->colour, p->type, i);
+    }
+    return hash;
+}
@@ -1,4 +1,4 @@
-import { WasmBridge } from './wasm/wasm_bridge.js';
+import { WasmBridge, SearchCancelled } from './wasm/wasm_bridge.js';
 import { Board, getPieceChar } from './ui/board.js';
 import { GameState } from './state/game_state.js';
 import { defaultFen } from './utils/constants.js';
@@ -6,6 +6,8 @@ import { FEN } from './fen/fen.js';
 
 (async function initApp() {
     const wasm = await new WasmBridge().init();
+    // from the devtools console: logEngineStats()
+    window.logEngineStats = () => wasm.logEngineStats();
 
     const chessboardEl = document.getElementById('chessboard');
     const statusEl = document.getElementById('status');
@@ -241,6 +243,7 @@ import { FEN } from './fen/fen.js';
     }
 
     resetBtn.addEventListener('click', () => {
+        wasm.cancelSearch();
         wasm.reset(defaultFen);
         moveHistory = [];
         capturedWhite = [];
@@ -292,11 +295,21 @@ import { FEN } from './fen/fen.js';
         wasm.setMovegen(moveGen);
     });
 
-    getMoveBtn.addEventListener('click', () => {
-        const bestMove = wasm.getBestMove();
-        if (bestMove && wasm.applyMove(bestMove)) {
-            addMove(bestMove);
-            updateUI();
+    getMoveBtn.addEventListener('click', async () => {
+        const fen = wasm.getFEN();
+        getMoveBtn.disabled = true;
+        try {
+            const bestMove = await wasm.getBestMove();
+            // the board may have moved on while the engine was thinking
+            if (bestMove && wasm.getFEN() === fen && wasm.applyMove(bestMove)) {
+                addMove(bestMove);
+                updateUI();
+            }
+        } catch (err) {
+            if (!(err instanceof SearchCancelled))
+                console.error('engine search failed', err);
+        } finally {
+            getMoveBtn.disabled = false;
         }
     });
 
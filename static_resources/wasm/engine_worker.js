@@ -0,0 +1,97 @@
+// Hosts a second copy of the engine so searches run off the main thread.
+// Requests are {id, method, args}; replies are {id, result} or {id, error}.
+importScripts('../chess.js');
+
+const BOARD_SIZE = 8;
+const TABLEBASES = ['KQK', 'KRK', 'KPK', 'KBK', 'KNK'];
+const ENGINE_STATS_LEN = 2048;
+
+let Module = null;
+const ready = App({ locateFile: path => '../' + path }).then(m => {
+    Module = m;
+    Module.ccall('init_game', null, ['number', 'number'], [BOARD_SIZE, BOARD_SIZE]);
+    return Promise.all([loadBook('../book.bin'), ...TABLEBASES.map(loadTablebase)]);
+});
+
+// Copies a fetched file into the engine, which owns the memory from then
+// on even if it rejects the data.
+async function handOver(url, exportName) {
+    const response = await fetch(url);
+    if (!response.ok)
+        throw new Error(`${url}: ${response.status}`);
+    const bytes = new Uint8Array(await response.arrayBuffer());
+    const ptr = Module._malloc(bytes.length);
+    Module.HEAPU8.set(bytes, ptr);
+    return !!Module.ccall(exportName, 'number', ['number', 'number'], [ptr, bytes.length]);
+}
+
+// The opening book and endgame tables are optional, the engine searches
+// every move without them.
+async function loadBook(url) {
+    try {
+        await handOver(url, 'load_book');
+    } catch (err) {
+        console.warn(`no opening book: ${err}`);
+    }
+}
+
+async function loadTablebase(signature) {
+    try {
+        await handOver(`../tb/${signature}.tb`, 'load_tablebase');
+    } catch (err) {
+        console.warn(`no ${signature} endgame table: ${err}`);
+    }
+}
+
+function readString(exportName, len) {
+    const ptr = Module._malloc(len);
+    try {
+        const used_len = Module.ccall(exportName, 'number', ['number', 'number'], [ptr, len]);
+        const buf = new Uint8Array(Module.HEAPU8.subarray(ptr, ptr + used_len));
+        return String.fromCharCode(...buf).replace(/\0/g, '');
+    } finally {
+        Module._free(ptr);
+    }
+}
+
+const methods = {
+    setFEN(fen) {
+        Module.ccall('set_fen', null, ['string'], [fen]);
+    },
+
+    getFEN() {
+        return readString('get_full_fen', 128);
+    },
+
+    applyMove(uci) {
+        return !!Module.ccall('apply_move_uci', 'number', ['string'], [uci]);
+    },
+
+    setMovegen(name) {
+        return !!Module.ccall('set_movegen', 'number', ['string'], [name]);
+    },
+
+    setSearchLimits(depth, timeMs, nodes) {
+        Module.ccall('set_search_limits', null, ['number', 'number', 'number'], [depth, timeMs, nodes]);
+    },
+
+    getBestMove() {
+        return readString('get_best_move', 8);
+    },
+
+    getEngineStats() {
+        return JSON.parse(readString('get_engine_stats', ENGINE_STATS_LEN));
+    },
+};
+
+self.onmessage = async (e) => {
+    const { id, method, args } = e.data;
+    try {
+        await ready;
+        if (!Object.hasOwn(methods, method))
+            throw new Error(`unknown engine method '${method}'`);
+        self.postMessage({ id, result: methods[method](...(args || [])) });
+    } catch (err) {
+        self.postMessage({ id, error: String((err && err.message) || err) });
+    }
+};
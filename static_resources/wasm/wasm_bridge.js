@@ -1,6 +1,127 @@
+const BOARD_SIZE = 8;
+const LEGAL_MOVE_BYTES = 3;
+const MAX_LEGAL_MOVES = 256;
+const ENGINE_STATS_LEN = 2048;
+const PROMOTION_LETTERS = ['', '', 'n', 'b', 'r', 'q', ''];
+
+function squareName(index) {
+    const file = String.fromCharCode(97 + index % BOARD_SIZE);
+    const rank = BOARD_SIZE - Math.floor(index / BOARD_SIZE);
+    return `${file}${rank}`;
+}
+
+function opponentSquares(fen) {
+    // the squares holding the side not to move's pieces
+    const [placement, turn] = fen.split(' ');
+    const opponentIsWhite = turn === 'b';
+    const squares = new Set();
+    let index = 0;
+    for (const c of placement) {
+        if (c === '/')
+            continue;
+        if (c >= '0' && c <= '9') {
+            index += Number(c);
+            continue;
+        }
+        if ((c === c.toUpperCase()) === opponentIsWhite)
+            squares.add(squareName(index));
+        index++;
+    }
+    return squares;
+}
+
+// The position the worker's game starts from and the moves played since,
+// back to the last capture or pawn move, so a search there sees the same
+// repetitions and fifty move count as the game here.
+export class MoveHistory {
+    constructor() {
+        this.reset('');
+    }
+
+    reset(fen) {
+        this.fen = fen;
+        this.moves = [];
+    }
+
+    played(uci, fen) {
+        // the halfmove clock goes back to 0 on a capture or pawn move, and
+        // nothing from before one can repeat
+        if (fen.split(' ')[4] === '0')
+            this.reset(fen);
+        else
+            this.moves.push(uci);
+    }
+
+    sendTo(engine) {
+        engine.call('setFEN', this.fen);
+        for (const uci of this.moves)
+            engine.call('applyMove', uci);
+    }
+}
+
+export class SearchCancelled extends Error {
+    constructor() {
+        super('search cancelled');
+        this.name = 'SearchCancelled';
+    }
+}
+
+// The engine's worker copy, answering promises in the order they were asked.
+// Without shared memory a running search can't see a stop request, so
+// cancelling terminates the worker and the next call starts a fresh one.
+class EngineWorker {
+    constructor() {
+        this.worker = null;
+        this.nextId = 0;
+        this.pending = new Map();
+    }
+
+    call(method, ...args) {
+        if (!this.worker) {
+            this.worker = new Worker(new URL('./engine_worker.js', import.meta.url));
+            this.worker.onmessage = e => this.onMessage(e.data);
+        }
+        const id = this.nextId++;
+        return new Promise((resolve, reject) => {
+            this.pending.set(id, { resolve, reject });
+            this.worker.postMessage({ id, method, args });
+        });
+    }
+
+    onMessage({ id, result, error }) {
+        const request = this.pending.get(id);
+        if (!request)
+            return;
+        this.pending.delete(id);
+        if (error !== undefined)
+            request.reject(new Error(error));
+        else
+            request.resolve(result);
+    }
+
+    get busy() {
+        return this.pending.size > 0;
+    }
+
+    cancel() {
+        if (!this.worker)
+            return;
+        this.worker.terminate();
+        this.worker = null;
+        for (const request of this.pending.values())
+            request.reject(new SearchCancelled());
+        this.pending.clear();
+    }
+}
+
 export class WasmBridge {
     constructor() {
         this.Module = null;
+        this.movesPtr = 0;
+        this.movesBySquare = null;
+        this.opponentSquares = null;
+        this.history = new MoveHistory();
+        this.engine = new EngineWorker();
     }
 
     async init() {
@@ -10,7 +131,9 @@ export class WasmBridge {
             script.onload = () => {
                 new App().then(Module => {
                     this.Module = Module;
-                    Module.ccall('init_game', null, ['number','number'], [8,8]);
+                    this.movesPtr = Module._malloc(MAX_LEGAL_MOVES * LEGAL_MOVE_BYTES);
+                    Module.ccall('init_game', null, ['number','number'], [BOARD_SIZE, BOARD_SIZE]);
+                    this.history.reset(this.getFEN());
                     resolve(this);
                 });
             };
@@ -22,7 +145,7 @@ export class WasmBridge {
         const len = 128;
         const ptr = this.Module._malloc(len);
         try {
-            const used_len = this.Module.ccall('get_fen', 'number', ['number', 'number'], [ptr, len]);
+            const used_len = this.Module.ccall('get_full_fen', 'number', ['number', 'number'], [ptr, len]);
             const fenBuf = new Uint8Array(this.Module.HEAPU8.subarray(ptr, ptr + used_len));
             const fen = String.fromCharCode(...fenBuf).replace(/\0/g, '');
             return fen;
@@ -32,11 +155,18 @@ export class WasmBridge {
     }
 
     setFEN(fen) {
+        this.movesBySquare = null;
         this.Module.ccall('set_fen', null, ['string'], [fen]);
+        this.history.reset(this.getFEN());
     }
 
     applyMove(uci) {
-        return this.Module.ccall('apply_move_uci', 'number', ['string'], [uci]);
+        const applied = this.Module.ccall('apply_move_uci', 'number', ['string'], [uci]);
+        if (applied) {
+            this.movesBySquare = null;
+            this.history.played(uci, this.getFEN());
+        }
+        return applied;
     }
 
     getStatusText(code) {
@@ -45,6 +175,8 @@ export class WasmBridge {
             case 1: return 'Check';
             case 2: return 'Checkmate';
             case 3: return 'Stalemate';
+            case 4: return 'Draw by repetition';
+            case 5: return 'Draw by the fifty move rule';
             default: return 'Unknown';
         }
     }
@@ -54,7 +186,8 @@ export class WasmBridge {
     }
 
     reset(defaultFEN) {
-        this.Module.ccall('init_game', null, ['number','number'], [8,8]);
+        this.movesBySquare = null;
+        this.Module.ccall('init_game', null, ['number','number'], [BOARD_SIZE, BOARD_SIZE]);
         this.setFEN(defaultFEN);
     }
 
@@ -86,20 +219,81 @@ export class WasmBridge {
         return ptr || '';
     }
 
-    getBestMove() {
-        const len = 8;
-        const ptr = this.Module._malloc(len);
+    async getBestMove({ timeMs } = {}) {
+        // searched in the worker on a copy of this game, reached by the same
+        // moves, the main thread stays free; only one search runs at a time
+        this.cancelSearch();
+        this.history.sendTo(this.engine);
+        this.engine.call('setMovegen', this.getMovegenName());
+        if (timeMs !== undefined)
+            this.engine.call('setSearchLimits', 0, timeMs, 0);
+        return this.engine.call('getBestMove');
+    }
+
+    cancelSearch() {
+        if (this.engine.busy)
+            this.engine.cancel();
+    }
+
+    getEngineStats() {
+        // counters are only filled in by an ENGINE_STATS build
+        const ptr = this.Module._malloc(ENGINE_STATS_LEN);
         try {
-            const used_len = this.Module.ccall('get_best_move', 'number', ['number', 'number'], [ptr, len]);
-            const moveBuf = new Uint8Array(this.Module.HEAPU8.subarray(ptr, ptr + used_len));
-            const moveStr = String.fromCharCode(...moveBuf).replace(/\0/g, '');
-            return moveStr;
+            const len = this.Module.ccall('get_engine_stats', 'number', ['number', 'number'], [ptr, ENGINE_STATS_LEN]);
+            const buf = new Uint8Array(this.Module.HEAPU8.subarray(ptr, ptr + len));
+            return JSON.parse(String.fromCharCode(...buf));
         } finally {
             this.Module._free(ptr);
         }
     }
 
+    async logEngineStats() {
+        // the page's copy does the rules work, the worker's the searching,
+        // and each keeps its own counters
+        const page = this.getEngineStats();
+        const worker = await this.engine.call('getEngineStats');
+        console.log('engine stats', { page, worker });
+        return { page, worker };
+    }
+
+    getLegalMoves() {
+        // every legal move for the side to move in one call, grouped by the
+        // square it starts from; kept until the position changes
+        if (this.movesBySquare)
+            return this.movesBySquare;
+        const count = this.Module.ccall('get_legal_moves_packed', 'number', ['number', 'number'], [this.movesPtr, MAX_LEGAL_MOVES]);
+        if (count < 0)
+            return null;
+        // a view, not a copy, so it is read before anything can grow the heap
+        const packed = this.Module.HEAPU8.subarray(this.movesPtr, this.movesPtr + count * LEGAL_MOVE_BYTES);
+        const bySquare = new Map();
+        for (let i = 0; i < packed.length; i += LEGAL_MOVE_BYTES) {
+            const from = squareName(packed[i]);
+            const uci = from + squareName(packed[i + 1]) + PROMOTION_LETTERS[packed[i + 2]];
+            if (!bySquare.has(from))
+                bySquare.set(from, []);
+            bySquare.get(from).push(uci);
+        }
+        this.movesBySquare = bySquare;
+        this.opponentSquares = opponentSquares(this.getFEN());
+        return bySquare;
+    }
+
     getAvailableMoves(pos) {
+        // a square missing from the packed moves is empty or has a piece
+        // that can't move, unless it is the opponent's, which only the
+        // per-square export answers for
+        const bySquare = this.getLegalMoves();
+        if (!bySquare)
+            return this.getAvailableMovesUCI(pos);
+        if (bySquare.has(pos))
+            return bySquare.get(pos);
+        if (!this.opponentSquares.has(pos))
+            return [];
+        return this.getAvailableMovesUCI(pos);
+    }
+
+    getAvailableMovesUCI(pos) {
         const len = 1024;
         const ptr = this.Module._malloc(len);
         try {
@@ -7,10 +7,27 @@ def pytest_html_report_title(report):
 def order():
     return [
             "test_status",
+            "test_game_handles",
+            "test_bitboards",
+            "test_attacks",
             "test_available_moves",
             "test_apply_move",
+            "test_make_unmake",
             "test_promotion",
+            "test_game_state",
+            "test_fen",
+            "test_hash",
+            "test_position_cache",
+            "test_perft",
             "test_movegen",
             "test_random",
             "test_fav_colour",
+            "test_selfplay",
+            "test_search",
+            "test_wasm_bridge",
+            "test_book",
+            "test_tablebase",
+            "test_batch",
+            "test_tt",
+            "test_engine_stats",
         ]
@@ -0,0 +1,42 @@
+import pytest
+
+from util import load_library, default_fen, fen_squares, count_attackers
+
+
+COLOURS = {"w": 1, "b": 2}
+
+
+positions = [
+        (8, 8, default_fen),
+        (8, 8, "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w"),
+        # rooks and queens stacked on a file and a diagonal, only the front
+        # one of each counts
+        (8, 8, "k7/8/3r4/3r4/8/1Q6/B7/K2R3q b"),
+        (6, 6, "rnbqkr/pppppp/6/6/PPPPPP/RNBQKR w"),
+        # past 64 squares the lookups walk the square lists instead
+        (10, 10, "k9/10/3r6/10/4Pp4/2N7/6b3/1Q8/8P1/K2R5q w"),
+    ]
+
+
+@pytest.mark.parametrize("width,height,fen", positions)
+def test_square_attackers(width, height, fen):
+    mod = load_library()
+    mod.init_game(width, height)
+    try:
+        assert mod.set_fen(fen.encode())
+        squares = fen_squares(fen, width)
+        for colour, white in ((COLOURS["w"], True), (COLOURS["b"], False)):
+            for i in range(width * height):
+                expected = count_attackers(squares, width, height, i, white)
+                assert mod.get_square_attackers(i, colour) == expected, \
+                    f"square {i} has the wrong number of attackers of colour {colour}"
+    finally:
+        mod.init_game(8, 8)
+
+
+def test_square_off_board():
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    assert mod.get_square_attackers(64, COLOURS["w"]) == -1
+    assert mod.get_square_attackers(-1, COLOURS["b"]) == -1
@@ -2,7 +2,7 @@ import pytest
 
 import ctypes
 
-from util import load_library, default_fen
+from util import load_library, default_fen, fen_squares, steps_from, KNIGHT_STEPS, KING_STEPS
 
 
 move_set = [
@@ -25,3 +25,117 @@ def test_available_moves(start_fen, piece, expected):
     extra_moves = set(expected) - move_set
     assert len(missing_moves) == 0, f"Missing moves: {missing_moves}"
     assert len(extra_moves) == 0, f"Extra moves: {extra_moves}"
+
+
+def test_available_moves_follow_applied_move():
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    assert mod.apply_move_uci(b"e2e4")
+    max_len = 128
+    moves = (ctypes.c_char * max_len)()
+    mod.get_available_moves_uci(b"e7", moves, max_len)
+    assert set(moves.value.decode().split(",")) == {"e7e6", "e7e5"}
+    mod.get_available_moves_uci(b"f1", moves, max_len)
+    assert set(moves.value.decode().split(",")) == {"f1e2", "f1d3", "f1c4", "f1b5", "f1a6"}
+
+
+def square_index(pos):
+    return (8 - int(pos[1])) * 8 + ord(pos[0]) - ord("a")
+
+
+def test_legal_moves_packed():
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    max_moves = 256
+    buf = (ctypes.c_ubyte * (max_moves * 3))()
+    count = mod.get_legal_moves_packed(buf, max_moves)
+    assert count == 20
+    moves = {(buf[i * 3], buf[i * 3 + 1], buf[i * 3 + 2]) for i in range(count)}
+    assert (square_index("e2"), square_index("e4"), 0) in moves
+    assert (square_index("g1"), square_index("f3"), 0) in moves
+    assert all(m[0] >= square_index("a2") for m in moves)
+
+
+def test_legal_moves_packed_promotion():
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(b"7k/P7/8/8/8/8/8/K7 w")
+    max_moves = 256
+    buf = (ctypes.c_ubyte * (max_moves * 3))()
+    count = mod.get_legal_moves_packed(buf, max_moves)
+    moves = [(buf[i * 3], buf[i * 3 + 1], buf[i * 3 + 2]) for i in range(count)]
+    promotions = sorted(m[2] for m in moves if m[0] == square_index("a7"))
+    assert promotions == [2, 3, 4, 5]
+    assert mod.get_legal_moves_packed(buf, 2) == 2
+
+
+# six queens on a 16x16 board have more moves than a move list holds, and
+# the king's, on the last square with a piece, come after the rest; only
+# a-h and 1-8 can be named
+wide_fen = "k15/16/16/16/6Q9/16/16/4Q3Q7/16/16/16/5Q3Q6/16/16/2Q13/7K8 w"
+
+
+def test_more_moves_than_list_holds():
+    mod = load_library()
+    mod.apply_move_uci.restype = ctypes.c_bool
+    mod.get_perft.restype = ctypes.c_double
+    mod.init_game(16, 16)
+    try:
+        assert mod.set_fen(wide_fen.encode())
+        assert int(mod.get_perft(1)) == 284
+        max_len = 256
+        moves = (ctypes.c_char * max_len)()
+        assert mod.get_available_moves_uci(b"h1", moves, max_len) > 0
+        assert set(moves.value.decode().split(",")) == {"h1g1", "h1g2", "h1h2", "h1i1", "h1i2"}
+        # the packed export can't hold them all, so the page asks per square
+        buf = (ctypes.c_ubyte * (256 * 3))()
+        assert mod.get_legal_moves_packed(buf, 256) == -1
+        assert mod.apply_move_uci(b"h1g1")
+    finally:
+        mod.init_game(8, 8)
+
+
+# knights and kings only, so every move comes straight from the step tables;
+# knights on corners and edges, and a king kept off a knight's squares
+step_positions = [
+        (8, 8, "N6k/8/8/3N4/2n5/8/8/K6N w"),
+        (6, 6, "N4k/6/2N3/6/6/K4N w"),
+        (10, 10, "N8k/10/10/10/4N5/10/10/10/1n8/K8N w"),
+    ]
+
+
+def step_moves(squares, width, height):
+    # white's moves, a king not stepping where a black piece attacks
+    def attacked(sq):
+        return any(squares[a] == "n" for a in steps_from(sq, KNIGHT_STEPS, width, height)) \
+            or any(squares[a] == "k" for a in steps_from(sq, KING_STEPS, width, height))
+
+    moves = set()
+    for i, letter in enumerate(squares):
+        if letter not in ("N", "K"):
+            continue
+        steps = KNIGHT_STEPS if letter == "N" else KING_STEPS
+        for to in steps_from(i, steps, width, height):
+            if squares[to].isupper() or (letter == "K" and attacked(to)):
+                continue
+            moves.add((i, to))
+    return moves
+
+
+@pytest.mark.parametrize("width,height,fen", step_positions)
+def test_step_moves(width, height, fen):
+    mod = load_library()
+    mod.init_game(width, height)
+    try:
+        assert mod.set_fen(fen.encode())
+        max_moves = 256
+        buf = (ctypes.c_ubyte * (max_moves * 3))()
+        count = mod.get_legal_moves_packed(buf, max_moves)
+        assert count > 0
+        moves = {(buf[i * 3], buf[i * 3 + 1]) for i in range(count)}
+        assert len(moves) == count, "a move was given twice"
+        assert moves == step_moves(fen_squares(fen, width), width, height)
+    finally:
+        mod.init_game(8, 8)
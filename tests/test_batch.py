@@ -0,0 +1,63 @@
+import pytest
+
+from util import load_library, default_fen, fools_mate_fen, SEARCH_DEFAULT_TIME_MS
+
+
+def analyse(tmp_path, lines, threads):
+    mod = load_library()
+    src = tmp_path / "in.epd"
+    dst = tmp_path / "out.epd"
+    src.write_text("".join(line + "\n" for line in lines))
+    mod.set_movegen(b"search")
+    mod.set_search_limits(2, 0, 0)
+    try:
+        count = mod.analyse_epd(str(src).encode(), str(dst).encode(), threads)
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+    return count, dst.read_text().splitlines()
+
+
+@pytest.mark.parametrize("threads", [1, 4])
+def test_batch_results(tmp_path, threads):
+    lines = [
+            "# re-scored",
+            default_fen + " KQkq - 0 1",
+            "",
+            "k7/8/1K6/8/8/8/8/6Q1 w - - bm g1a7; id \"mate; in one\";",
+            fools_mate_fen,
+            "not a position",
+            "8/8/8/8/8/8/8/8 w",
+        ]
+    count, out = analyse(tmp_path, lines, threads)
+    assert count == 3
+    assert out == [
+            "# re-scored",
+            default_fen + " KQkq - 0 1 bm " + out[1].split(" bm ")[1].split(";")[0] + "; ce 0; status ongoing;",
+            "",
+            "k7/8/1K6/8/8/8/8/6Q1 w - - bm g1g8; ce 830; status ongoing; id \"mate; in one\";",
+            fools_mate_fen + " status checkmate;",
+            "not a position status invalid;",
+            "8/8/8/8/8/8/8/8 w status invalid;",
+        ]
+
+
+def test_batch_keeps_order(tmp_path):
+    # several windows' worth, so slots are reused while workers are busy
+    fens = [
+            default_fen,
+            "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b",
+            "k7/8/1K6/8/8/8/8/6Q1 w",
+            fools_mate_fen,
+        ]
+    lines = [fens[i % len(fens)] + f" id \"{i}\";" for i in range(1000)]
+    count, out = analyse(tmp_path, lines, 4)
+    assert count == len(lines)
+    assert len(out) == len(lines)
+    for i, line in enumerate(out):
+        assert line.startswith(fens[i % len(fens)] + " ")
+        assert line.endswith(f" id \"{i}\";")
+
+
+def test_batch_missing_file(tmp_path):
+    mod = load_library()
+    assert mod.analyse_epd(str(tmp_path / "missing.epd").encode(), str(tmp_path / "out.epd").encode(), 1) == -1
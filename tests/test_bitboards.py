@@ -0,0 +1,91 @@
+import ctypes
+
+import pytest
+
+from util import load_library, default_fen, fen_squares
+
+
+COLOURS = {"w": 1, "b": 2}
+PIECE_TYPES = {"": 0, "p": 1, "n": 2, "b": 3, "r": 4, "q": 5, "k": 6}
+
+
+def get_mask(mod, colour, piece_type):
+    max_len = 32
+    mask = (ctypes.c_char * max_len)()
+    len_ = mod.get_piece_mask(colour, piece_type, mask, max_len)
+    assert len_ == 16, "mask not written"
+    return int(mask.value.decode(), 16)
+
+
+def masks_from_fen(fen, width):
+    # the masks the square array says there should be, bit n for square n
+    masks = {(c, t): 0 for c in COLOURS.values() for t in PIECE_TYPES.values()}
+    for i, letter in enumerate(fen_squares(fen, width)):
+        if not letter:
+            continue
+        colour = COLOURS["w" if letter.isupper() else "b"]
+        masks[(colour, PIECE_TYPES[letter.lower()])] |= 1 << i
+        masks[(colour, 0)] |= 1 << i
+    return masks
+
+
+def check_masks(mod, width=8):
+    max_len = 256
+    fen = (ctypes.c_char * max_len)()
+    assert mod.get_fen(fen, max_len), "not given fen back"
+    expected = masks_from_fen(fen.value.decode(), width)
+    for (colour, piece_type), mask in expected.items():
+        assert get_mask(mod, colour, piece_type) == mask, \
+            f"mask of colour {colour} type {piece_type} differs from the squares"
+
+
+def test_start_position():
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    # squares count from a8, so white's pawns sit on bits 48 to 55
+    assert get_mask(mod, COLOURS["w"], PIECE_TYPES["p"]) == 0x00ff000000000000
+    assert get_mask(mod, COLOURS["b"], PIECE_TYPES[""]) == 0x000000000000ffff
+    check_masks(mod)
+
+
+games = [
+        # captures, castling both ways, en passant and promotion
+        (default_fen, ("e2e4", "d7d5", "e4d5", "d8d5", "g1f3", "c8g4", "f1e2", "b8c6", "e1g1", "e8c8")),
+        ("4k3/8/8/8/1p6/8/P7/4K3 w", ("a2a4", "b4a3", "e1d1", "a3a2", "d1c2", "a2a1q", "c2b3")),
+        ("r3k2r/8/8/8/8/8/8/R3K2R w", ("a1a8", "e8e7", "h1h7", "e7d6", "e1d2")),
+    ]
+
+
+@pytest.mark.parametrize("start_fen,moves", games)
+def test_masks_follow_moves(start_fen, moves):
+    mod = load_library()
+    mod.apply_move_uci.restype = ctypes.c_bool
+    mod.init_game(8, 8)
+    mod.set_fen(start_fen.encode())
+    check_masks(mod)
+    for m in moves:
+        assert mod.apply_move_uci(m.encode()), f"move {m} is reported invalid"
+        check_masks(mod)
+
+
+def test_masks_of_smaller_board():
+    mod = load_library()
+    mod.init_game(6, 6)
+    try:
+        assert mod.set_fen(b"rnbqkr/pppppp/6/6/PPPPPP/RNBQKR w")
+        check_masks(mod, 6)
+        assert get_mask(mod, COLOURS["w"], PIECE_TYPES["k"]) == 1 << 34
+    finally:
+        mod.init_game(8, 8)
+
+
+def test_no_masks_past_64_squares():
+    mod = load_library()
+    mod.init_game(10, 10)
+    try:
+        max_len = 32
+        mask = (ctypes.c_char * max_len)()
+        assert mod.get_piece_mask(COLOURS["w"], PIECE_TYPES[""], mask, max_len) == 0
+    finally:
+        mod.init_game(8, 8)
@@ -0,0 +1,88 @@
+import ctypes
+import struct
+
+from util import load_library, check_expected_move, default_fen, SEARCH_DEFAULT_TIME_MS
+
+
+BOOK_MAGIC = b"WCBOOK02"
+
+
+def position_hash(fen):
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(fen.encode())
+    max_len = 17
+    hex_ = (ctypes.c_char * max_len)()
+    mod.get_position_hash(hex_, max_len)
+    return int(hex_.value.decode(), 16)
+
+
+def square(name):
+    # square index 0 is a8
+    return (8 - int(name[1])) * 8 + ord(name[0]) - ord("a")
+
+
+def write_book(path, entries):
+    data = BOOK_MAGIC + struct.pack("<II", len(entries), 0)
+    for key, uci, weight in sorted(entries):
+        data += struct.pack("<QHHBBH", key, square(uci[:2]), square(uci[2:4]), 0, 0, weight)
+    path.write_bytes(data)
+    return str(path).encode()
+
+
+def test_book_move(tmp_path):
+    mod = load_library()
+    key = position_hash(default_fen)
+    path = write_book(tmp_path / "book.bin", [(key, "h2h4", 1), (key - 1, "a2a3", 5), (key + 1, "b2b3", 5)])
+    assert mod.open_book(path)
+    mod.set_search_limits(2, 0, 0)
+    try:
+        assert mod.get_book_entries() == 3
+        check_expected_move("search", default_fen, "h2h4")
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+        mod.close_book()
+
+
+def test_book_follows_line(tmp_path):
+    mod = load_library()
+    fen = "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b"
+    path = write_book(tmp_path / "book.bin", [(position_hash(fen), "a7a5", 1)])
+    assert mod.open_book(path)
+    try:
+        check_expected_move("fav_colour", fen, "a7a5")
+    finally:
+        mod.close_book()
+
+
+def test_book_illegal_move_ignored(tmp_path):
+    mod = load_library()
+    key = position_hash(default_fen)
+    path = write_book(tmp_path / "book.bin", [(key, "a1a8", 1)])
+    assert mod.open_book(path)
+    try:
+        check_expected_move("random", default_fen)
+    finally:
+        mod.close_book()
+
+
+def test_book_rejects_garbage(tmp_path):
+    mod = load_library()
+    path = tmp_path / "book.bin"
+    path.write_bytes(b"not a book at all")
+    assert not mod.open_book(str(path).encode())
+    assert mod.get_book_entries() == 0
+    truncated = BOOK_MAGIC + struct.pack("<II", 10, 0)
+    path.write_bytes(truncated)
+    assert not mod.open_book(str(path).encode())
+
+
+def test_book_rejects_old_version(tmp_path):
+    # books from before castling and en passant were hashed
+    mod = load_library()
+    path = write_book(tmp_path / "book.bin", [(position_hash(default_fen), "e2e4", 1)])
+    data = bytearray(open(path, "rb").read())
+    data[:8] = b"WCBOOK01"
+    (tmp_path / "book.bin").write_bytes(bytes(data))
+    assert not mod.open_book(path)
+    assert mod.get_book_entries() == 0
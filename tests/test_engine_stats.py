@@ -0,0 +1,65 @@
+import ctypes
+import json
+
+from util import load_library, default_fen, SEARCH_DEFAULT_TIME_MS
+
+
+def get_engine_stats(mod):
+    max_len = 2048
+    buf = (ctypes.c_char * max_len)()
+    len_ = mod.get_engine_stats(buf, max_len)
+    assert len_ > 0
+    return json.loads(buf.value.decode())
+
+
+def test_engine_stats_counts():
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    mod.reset_engine_stats()
+    stats = get_engine_stats(mod)
+    # the test library is built with ENGINE_STATS
+    assert stats["enabled"]
+    assert all(v == 0 for v in stats["counters"].values())
+
+    assert mod.apply_move_uci(b"e2e4")
+    mod.get_perft.restype = ctypes.c_double
+    nodes = mod.get_perft(2)
+    mod.set_movegen(b"search")
+    mod.set_search_limits(2, 0, 0)
+    try:
+        max_len = 10
+        uci = (ctypes.c_char * max_len)()
+        assert mod.get_best_move(uci, max_len)
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+
+    stats = get_engine_stats(mod)
+    counters = stats["counters"]
+    phases = stats["phases"]
+    assert counters["moves_generated"] >= nodes
+    assert counters["moves_made"] > 0
+    assert counters["is_square_attacked"] > 0
+    assert counters["nodes"] > 0
+    assert counters["evaluations"] > 0
+    for phase in ("apply_move", "status", "perft", "best_move", "book", "tablebase", "generator"):
+        assert phases[phase]["calls"] >= 1, phase
+    assert phases["perft"]["calls"] == 1
+
+
+def test_engine_stats_reset():
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    mod.get_perft(1)
+    mod.reset_engine_stats()
+    stats = get_engine_stats(mod)
+    assert all(v == 0 for v in stats["counters"].values())
+    assert all(p["calls"] == 0 and p["us"] == 0 for p in stats["phases"].values())
+
+
+def test_engine_stats_short_buffer():
+    mod = load_library()
+    max_len = 16
+    buf = (ctypes.c_char * max_len)()
+    assert mod.get_engine_stats(buf, max_len) == -1
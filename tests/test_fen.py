@@ -0,0 +1,95 @@
+import ctypes
+
+import pytest
+
+from util import load_library, default_fen
+
+
+empty_fen = "8/8/8/8/8/8/8/8 w"
+
+
+def load_fen():
+    mod = load_library()
+    mod.set_fen.restype = ctypes.c_bool
+    mod.create_game.restype = ctypes.c_void_p
+    mod.destroy_game.argtypes = [ctypes.c_void_p]
+    mod.set_game_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    mod.set_game_fen.restype = ctypes.c_bool
+    mod.get_game_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+    return mod
+
+
+def get_fen(mod, max_len=128):
+    fen = (ctypes.c_char * max_len)()
+    len_ = mod.get_fen(fen, max_len)
+    return len_, fen.value.decode()
+
+
+@pytest.mark.parametrize("fen, expected", [
+    ("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", default_fen),
+    ("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+        "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b"),
+    ("4k3/8/8/8/8/8/8/4K3 b - - 12 40", "4k3/8/8/8/8/8/8/4K3 b"),
+    ("4k3/8/8/8/8/8/8/4K3 w; id \"epd\"", "4k3/8/8/8/8/8/8/4K3 w"),
+    ("  4k3/8/8/8/8/8/8/4K3", "4k3/8/8/8/8/8/8/4K3 w"),
+])
+def test_fen_fields(fen, expected):
+    mod = load_fen()
+    mod.init_game(8, 8)
+    assert mod.set_fen(fen.encode())
+    len_, out = get_fen(mod)
+    assert out == expected
+    assert len_ == len(expected)
+
+
+@pytest.mark.parametrize("fen", [
+    "",
+    "4k3/8/8/8/8/8/8 w",
+    "4k3/8/8/8/8/8/8/8/4K3 w",
+    "4k4/8/8/8/8/8/8/4K3 w",
+    "4k2/8/8/8/8/8/8/4K3 w",
+    "4x3/8/8/8/8/8/8/4K3 w",
+    "4k3/8/8/8/8/8/8/0K7 w",
+    "4k3/8/8/8/8/8/8/4K3w",
+])
+def test_malformed_fen(fen):
+    mod = load_fen()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    assert not mod.set_fen(fen.encode())
+    assert get_fen(mod)[1] == empty_fen
+
+
+def test_optional_fields_stop_at_first_bad():
+    # a bad side to move, castling or en passant ends the position there
+    mod = load_fen()
+    mod.init_game(8, 8)
+    assert mod.set_fen(b"4k3/8/8/8/8/8/8/4K3 b KQxq - 0 1")
+    assert get_fen(mod)[1] == "4k3/8/8/8/8/8/8/4K3 b"
+    assert mod.set_fen(b"4k3/8/8/8/8/8/8/4K3 x")
+    assert get_fen(mod)[1] == "4k3/8/8/8/8/8/8/4K3 w"
+
+
+def test_other_dimensions():
+    mod = load_fen()
+    game = mod.create_game(10, 6)
+    try:
+        fen = "r3k4r/pppppppppp/10/10/PPPPPPPPPP/R3K4R b"
+        assert mod.set_game_fen(game, fen.encode())
+        max_len = 128
+        out = (ctypes.c_char * max_len)()
+        assert mod.get_game_fen(game, out, max_len) == len(fen)
+        assert out.value.decode() == fen
+        # an 8x8 position doesn't fit
+        assert not mod.set_game_fen(game, default_fen.encode())
+    finally:
+        mod.destroy_game(game)
+
+
+def test_short_buffer():
+    mod = load_fen()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    len_, out = get_fen(mod, 10)
+    assert len_ == -1
+    assert default_fen.startswith(out)
@@ -0,0 +1,150 @@
+import ctypes
+import json
+import threading
+
+from util import load_library, default_fen, fools_mate_fen, STATUS
+
+
+TT_DEFAULT_SIZE_MB = 4
+
+
+def load_handles():
+    mod = load_library()
+    mod.create_game.restype = ctypes.c_void_p
+    mod.destroy_game.argtypes = [ctypes.c_void_p]
+    mod.set_game_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    mod.get_game_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+    mod.get_game_status.argtypes = [ctypes.c_void_p]
+    mod.apply_game_move_uci.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    mod.apply_game_move_uci.restype = ctypes.c_bool
+    mod.get_game_best_move.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+    mod.set_game_search_limits.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    return mod
+
+
+def game_fen(mod, game):
+    max_len = 128
+    fen = (ctypes.c_char * max_len)()
+    assert mod.get_game_fen(game, fen, max_len), "not given fen back"
+    return fen.value.decode()
+
+
+def test_games_are_independent():
+    mod = load_handles()
+    first = mod.create_game(8, 8)
+    second = mod.create_game(8, 8)
+    try:
+        mod.set_game_fen(first, default_fen.encode())
+        mod.set_game_fen(second, fools_mate_fen.encode())
+        assert mod.apply_game_move_uci(first, b"e2e4")
+        assert game_fen(mod, second) == fools_mate_fen
+        assert STATUS(mod.get_game_status(second)) == STATUS.CHECKMATE
+        assert STATUS(mod.get_game_status(first)) == STATUS.ONGOING
+        assert game_fen(mod, first) != default_fen
+    finally:
+        mod.destroy_game(first)
+        mod.destroy_game(second)
+
+
+def test_default_game_untouched():
+    mod = load_handles()
+    mod.init_game(8, 8)
+    mod.set_fen(fools_mate_fen.encode())
+    game = mod.create_game(8, 8)
+    try:
+        mod.set_game_fen(game, default_fen.encode())
+        assert mod.apply_game_move_uci(game, b"d2d4")
+        assert STATUS(mod.get_status()) == STATUS.CHECKMATE
+    finally:
+        mod.destroy_game(game)
+
+
+def test_concurrent_searches():
+    mod = load_handles()
+    fens = [
+            ("6k1/5ppp/8/8/8/8/5PPP/R5K1 w", "a1a8"),
+            ("r5k1/5ppp/8/8/8/8/5PPP/6K1 b", "a8a1"),
+        ]
+    games = [mod.create_game(8, 8) for _ in fens]
+    results = [None] * len(fens)
+
+    def search(i):
+        max_len = 10
+        uci = (ctypes.c_char * max_len)()
+        if mod.get_game_best_move(games[i], uci, max_len):
+            results[i] = uci.value.decode()
+
+    mod.set_movegen(b"search")
+    try:
+        for game, (fen, _) in zip(games, fens):
+            mod.set_game_fen(game, fen.encode())
+            mod.set_game_search_limits(game, 3, 0, 0)
+        threads = [threading.Thread(target=search, args=(i,)) for i in range(len(fens))]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        assert results == [expected for _, expected in fens]
+    finally:
+        for game in games:
+            mod.destroy_game(game)
+
+
+def search_nodes(mod, game):
+    max_len = 2048
+    stats = (ctypes.c_char * max_len)()
+    mod.reset_engine_stats()
+    uci = (ctypes.c_char * 10)()
+    assert mod.get_game_best_move(game, uci, 10)
+    assert mod.get_engine_stats(stats, max_len) > 0
+    return json.loads(stats.value.decode())["counters"]["nodes"]
+
+
+def test_search_limits_per_game():
+    mod = load_handles()
+    fen = "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w"
+    games = [mod.create_game(8, 8) for _ in range(2)]
+    mod.set_movegen(b"search")
+    # without a table each search does the same work every time
+    assert mod.set_hash_size(0)
+    try:
+        for game in games:
+            mod.set_game_fen(game, fen.encode())
+        mod.set_game_search_limits(games[0], 1, 0, 0)
+        shallow = search_nodes(mod, games[0])
+        mod.set_game_search_limits(games[1], 3, 0, 0)
+        assert search_nodes(mod, games[1]) > shallow
+        assert search_nodes(mod, games[0]) == shallow
+    finally:
+        mod.set_hash_size(TT_DEFAULT_SIZE_MB)
+        for game in games:
+            mod.destroy_game(game)
+
+
+def test_concurrent_first_games_of_a_size():
+    mod = load_handles()
+    mod.get_game_legal_moves_packed.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int]
+    mod.get_game_position_hash.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+    # no other test uses this size, so the threads race to build its tables
+    fen = "k11/12/12/12/12/5Q6/12/12/12/12/12/11K w"
+    thread_count = 8
+    results = [None] * thread_count
+
+    def play(i):
+        game = mod.create_game(12, 12)
+        try:
+            mod.set_game_fen(game, fen.encode())
+            moves = (ctypes.c_ubyte * (256 * 3))()
+            hash_hex = (ctypes.c_char * 32)()
+            assert mod.get_game_position_hash(game, hash_hex, 32) > 0
+            results[i] = (mod.get_game_legal_moves_packed(game, moves, 256), hash_hex.value)
+        finally:
+            mod.destroy_game(game)
+
+    threads = [threading.Thread(target=play, args=(i,)) for i in range(thread_count)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    assert results[0][0] > 0
+    assert results == [results[0]] * thread_count
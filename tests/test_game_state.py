@@ -0,0 +1,126 @@
+import ctypes
+
+import pytest
+
+from util import load_library, default_fen, STATUS
+
+
+def load_state(fen):
+    mod = load_library()
+    mod.apply_move_uci.restype = ctypes.c_bool
+    mod.init_game(8, 8)
+    assert mod.set_fen(fen.encode())
+    return mod
+
+
+def full_fen(mod):
+    max_len = 128
+    fen = (ctypes.c_char * max_len)()
+    assert mod.get_full_fen(fen, max_len) > 0
+    return fen.value.decode()
+
+
+def play(mod, moves):
+    for uci in moves.split():
+        assert mod.apply_move_uci(uci.encode()), uci
+
+
+def test_full_fen_round_trip():
+    fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w Kq - 3 12"
+    mod = load_state(fen)
+    assert full_fen(mod) == fen
+
+
+def test_short_fen_infers_castling():
+    mod = load_state(default_fen)
+    assert full_fen(mod) == default_fen + " KQkq - 0 1"
+
+
+def test_clocks():
+    mod = load_state(default_fen)
+    play(mod, "g1f3 g8f6 b1c3")
+    assert full_fen(mod).endswith(" b KQkq - 3 2")
+    play(mod, "e7e5")
+    assert full_fen(mod).endswith(" w KQkq - 0 3")
+
+
+def test_en_passant_square():
+    # only kept while a pawn can take onto it
+    mod = load_state("4k3/8/8/8/3p4/8/4P1P1/4K3 w - - 0 1")
+    play(mod, "g2g4")
+    assert " b - - " in full_fen(mod)
+    play(mod, "e8e7 e2e4")
+    assert " b - e3 " in full_fen(mod)
+    play(mod, "d4e3")
+    assert full_fen(mod) == "8/4k3/8/8/6P1/4p3/8/4K3 w - - 0 3"
+
+
+def test_en_passant_only_straight_after():
+    mod = load_state("4k3/8/8/8/3p4/8/4P3/4K3 w - - 0 1")
+    play(mod, "e2e4 e8e7 e1d1")
+    assert not mod.apply_move_uci(b"d4e3")
+    # and never against a pawn that stepped one square at a time
+    mod = load_state("4k3/8/8/8/3pP3/8/8/4K3 b - - 0 1")
+    assert not mod.apply_move_uci(b"d4e3")
+
+
+@pytest.mark.parametrize("moves, castling, illegal", [
+    ("h1h2 h8h7 h2h1 h7h8", "Qq", "e1g1"),
+    ("a1a2 a8a7 a2a1 a7a8", "Kk", "e1c1"),
+    ("e1f1 e8f8 f1e1 f8e8", "-", "e1g1"),
+    ("h1h8", "Qq", "e8g8"),
+])
+def test_castling_rights(moves, castling, illegal):
+    mod = load_state("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1")
+    play(mod, moves)
+    assert full_fen(mod).split()[2] == castling
+    if STATUS(mod.get_status()) != STATUS.ONGOING:
+        return
+    assert not mod.apply_move_uci(illegal.encode())
+
+
+def test_castling_field_overrides_placement():
+    mod = load_state("r3k2r/8/8/8/8/8/8/R3K2R w - - 0 1")
+    assert not mod.apply_move_uci(b"e1g1")
+    mod = load_state("r3k2r/8/8/8/8/8/8/R3K2R w K - 0 1")
+    assert mod.apply_move_uci(b"e1g1")
+    assert full_fen(mod) == "r3k2r/8/8/8/8/8/8/R4RK1 b - - 1 1"
+
+
+def test_threefold_repetition():
+    mod = load_state(default_fen)
+    play(mod, "g1f3 g8f6 f3g1 f6g8")
+    assert STATUS(mod.get_status()) == STATUS.ONGOING
+    play(mod, "g1f3 g8f6 f3g1")
+    assert STATUS(mod.get_status()) == STATUS.ONGOING
+    play(mod, "f6g8")
+    assert STATUS(mod.get_status()) == STATUS.REPETITION
+    assert not mod.apply_move_uci(b"e2e4")
+
+
+def test_repetition_needs_same_rights():
+    # the first position still had castling rights, so it isn't repeated
+    mod = load_state("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1")
+    play(mod, "e1f1 e8f8 f1e1 f8e8 e1f1 e8f8 f1e1 f8e8")
+    assert STATUS(mod.get_status()) == STATUS.ONGOING
+    play(mod, "e1f1 e8f8")
+    assert STATUS(mod.get_status()) == STATUS.REPETITION
+
+
+def test_fifty_move_rule():
+    mod = load_state("4k3/8/8/8/8/8/P7/R3K3 w - - 98 60")
+    play(mod, "a1b1")
+    assert STATUS(mod.get_status()) == STATUS.ONGOING
+    play(mod, "e8d8")
+    assert STATUS(mod.get_status()) == STATUS.FIFTY_MOVES
+    # a pawn move resets the clock
+    mod = load_state("4k3/8/8/8/8/8/P7/R3K3 w - - 98 60")
+    play(mod, "a2a3 e8d8")
+    assert STATUS(mod.get_status()) == STATUS.ONGOING
+    assert full_fen(mod).endswith(" w - - 1 61")
+
+
+def test_mate_stands_over_fifty_moves():
+    mod = load_state("7k/8/6K1/8/8/8/8/R7 w - - 99 80")
+    play(mod, "a1a8")
+    assert STATUS(mod.get_status()) == STATUS.CHECKMATE
@@ -0,0 +1,51 @@
+import ctypes
+
+import pytest
+
+from util import load_library, default_fen
+
+
+def get_hash(mod):
+    max_len = 32
+    hash_ = (ctypes.c_char * max_len)()
+    len_ = mod.get_position_hash(hash_, max_len)
+    assert len_ == 16, "hash not written"
+    return hash_.value.decode()
+
+
+def hash_after(start_fen, moves):
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(start_fen.encode())
+    for m in moves:
+        assert mod.apply_move_uci(m.encode()), f"move {m} is reported invalid"
+    return get_hash(mod)
+
+
+transpositions = [
+        (default_fen, ("g1f3", "g8f6", "f3g1", "f6g8"), ()),
+        (default_fen, ("g1f3", "g8f6", "b1c3"), ("b1c3", "g8f6", "g1f3")),
+        (default_fen, ("e2e4", "e7e5", "g1f3"), ("g1f3", "e7e5", "e2e4")),
+    ]
+
+incremental = [
+        (default_fen, ("a2a4", "a7a5"), "rnbqkbnr/1ppppppp/8/p7/P7/8/1PPPPPPP/RNBQKBNR w"),
+        (default_fen, ("e2e4", "d7d5", "e4d5"), "rnbqkbnr/ppp1pppp/8/3P4/8/8/PPPP1PPP/RNBQKBNR b"),
+        ("rnbqkbnr/ppp3Pp/8/3p4/8/8/PPP1PPPP/RNBQKBNR w", ("g7h8q",), "rnbqkbnQ/ppp4p/8/3p4/8/8/PPP1PPPP/RNBQKBNR b"),
+    ]
+
+
+@pytest.mark.parametrize("start_fen,moves,other_moves", transpositions)
+def test_transposition(start_fen, moves, other_moves):
+    assert hash_after(start_fen, moves) == hash_after(start_fen, other_moves), "same position hashed differently"
+
+
+@pytest.mark.parametrize("start_fen,moves,end_fen", incremental)
+def test_incremental(start_fen, moves, end_fen):
+    assert hash_after(start_fen, moves) == hash_after(end_fen, ()), "incremental hash differs from fresh hash"
+
+
+def test_side_to_move():
+    white = hash_after("4k3/8/8/8/8/8/8/4K3 w", ())
+    black = hash_after("4k3/8/8/8/8/8/8/4K3 b", ())
+    assert white != black, "side to move not hashed"
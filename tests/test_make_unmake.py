@@ -0,0 +1,70 @@
+import ctypes
+
+import pytest
+
+from util import load_library, default_fen
+
+
+def legal_move_count(mod):
+    max_moves = 256
+    buf = (ctypes.c_ubyte * (max_moves * 3))()
+    return mod.get_legal_moves_packed(buf, max_moves)
+
+
+def get_full_fen(mod):
+    max_len = 256
+    fen = (ctypes.c_char * max_len)()
+    assert mod.get_full_fen(fen, max_len), "not given fen back"
+    return fen.value.decode()
+
+
+def get_hash(mod):
+    max_len = 32
+    hash_ = (ctypes.c_char * max_len)()
+    assert mod.get_position_hash(hash_, max_len) == 16, "hash not written"
+    return hash_.value.decode()
+
+
+def check_round_trip(mod):
+    fen, hash_ = get_full_fen(mod), get_hash(mod)
+    count = legal_move_count(mod)
+    assert mod.check_make_unmake() == count, "a move didn't come back to the same board"
+    assert get_full_fen(mod) == fen
+    assert get_hash(mod) == hash_
+
+
+positions = [
+        (8, 8, default_fen + " KQkq - 0 1"),
+        # castling both ways, and pawns a step from promoting
+        (8, 8, "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"),
+        (8, 8, "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"),
+        (8, 8, "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1"),
+        # en passant for white, then for black
+        (8, 8, "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3"),
+        (8, 8, "rnbqkbnr/pppp1ppp/8/8/3PpP2/8/PPP1P1PP/RNBQKBNR b KQkq d3 0 3"),
+        (10, 10, "k9/10/3r6/10/4Pp4/2N7/6b3/1Q8/8P1/K2R5q w"),
+    ]
+
+
+@pytest.mark.parametrize("width,height,fen", positions)
+def test_round_trip(width, height, fen):
+    mod = load_library()
+    mod.init_game(width, height)
+    try:
+        assert mod.set_fen(fen.encode())
+        assert legal_move_count(mod) > 0
+        check_round_trip(mod)
+    finally:
+        mod.init_game(8, 8)
+
+
+def test_round_trip_through_game():
+    mod = load_library()
+    mod.apply_move_uci.restype = ctypes.c_bool
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    moves = ("e2e4", "d7d5", "e4e5", "f7f5", "e5f6", "g8h6", "f6g7", "e8f7", "g7h8q", "f8g7")
+    for m in moves:
+        check_round_trip(mod)
+        assert mod.apply_move_uci(m.encode()), f"move {m} is reported invalid"
+    check_round_trip(mod)
@@ -0,0 +1,33 @@
+import ctypes
+import os
+import pytest
+
+from util import load_library
+
+
+SUITE_PATH = os.path.join(os.path.dirname(__file__), "..", "tools", "perft.epd")
+MAX_NODES = 100000
+
+
+def load_suite():
+    cases = []
+    with open(SUITE_PATH) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            fen, *entries = line.split(";")
+            for entry in entries:
+                depth, nodes = entry.split()
+                if int(nodes) <= MAX_NODES:
+                    cases.append((fen.strip(), int(depth[1:]), int(nodes)))
+    return cases
+
+
+@pytest.mark.parametrize("fen,depth,expected", load_suite())
+def test_perft(fen, depth, expected):
+    mod = load_library()
+    mod.get_perft.restype = ctypes.c_double
+    mod.init_game(8, 8)
+    mod.set_fen(fen.encode())
+    assert int(mod.get_perft(depth)) == expected
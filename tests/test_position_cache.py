@@ -0,0 +1,135 @@
+import ctypes
+
+from util import load_library, default_fen, fools_mate_fen, STATUS, SEARCH_DEFAULT_TIME_MS
+
+
+POSCACHE_DEFAULT_ENTRIES = 64
+STATS_LEN = 6
+# out of the book and the endgame tables
+search_fen = "k2q4/8/8/8/8/8/8/nR5K w"
+
+
+def get_position_cache_stats(mod):
+    stats = (ctypes.c_double * STATS_LEN)()
+    assert mod.get_position_cache_stats(stats, STATS_LEN) == STATS_LEN
+    capacity, used, hits, misses, best_move_hits, evictions = stats
+    return dict(capacity=capacity, used=used, hits=hits, misses=misses,
+                best_move_hits=best_move_hits, evictions=evictions)
+
+
+def available_moves(mod, pos):
+    buflen = 256
+    buf = (ctypes.c_char * buflen)()
+    mod.get_available_moves_uci(pos.encode(), buf, buflen)
+    return buf.value.decode()
+
+
+def best_move(mod):
+    max_len = 10
+    uci = (ctypes.c_char * max_len)()
+    assert mod.get_best_move(uci, max_len)
+    return uci.value.decode()
+
+
+def test_position_cache_replay():
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    before = available_moves(mod, "g1")
+    assert mod.apply_move_uci(b"e2e4")
+    assert mod.apply_move_uci(b"e7e5")
+    stats = get_position_cache_stats(mod)
+    assert stats["capacity"] == POSCACHE_DEFAULT_ENTRIES
+    assert stats["used"] == 3
+    assert stats["hits"] == 0
+
+    # going back to the start finds it cached, with the same moves
+    mod.set_fen(default_fen.encode())
+    stats = get_position_cache_stats(mod)
+    assert stats["hits"] == 1
+    assert stats["used"] == 3
+    assert available_moves(mod, "g1") == before
+    assert STATUS(mod.get_status()) == STATUS.ONGOING
+
+
+def test_position_cache_status():
+    mod = load_library()
+    mod.init_game(8, 8)
+    for _ in range(2):
+        mod.set_fen(fools_mate_fen.encode())
+        assert STATUS(mod.get_status()) == STATUS.CHECKMATE
+    assert get_position_cache_stats(mod)["hits"] == 1
+
+
+def test_position_cache_evicts_least_recent():
+    mod = load_library()
+    mod.init_game(8, 8)
+    assert mod.set_position_cache_size(2)
+    try:
+        fens = [
+                default_fen,
+                "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b",
+                "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w",
+            ]
+        mod.set_fen(fens[0].encode())
+        mod.set_fen(fens[1].encode())
+        mod.set_fen(fens[0].encode())
+        mod.set_fen(fens[2].encode())
+        stats = get_position_cache_stats(mod)
+        assert stats["used"] == 2
+        assert stats["hits"] == 1
+        assert stats["evictions"] == 1
+        # the second was least recently used, so it went
+        mod.set_fen(fens[0].encode())
+        mod.set_fen(fens[1].encode())
+        stats = get_position_cache_stats(mod)
+        assert stats["hits"] == 2
+        assert stats["evictions"] == 2
+    finally:
+        mod.set_position_cache_size(POSCACHE_DEFAULT_ENTRIES)
+
+
+def test_position_cache_best_move():
+    mod = load_library()
+    mod.set_search_limits(2, 0, 0)
+    try:
+        mod.init_game(8, 8)
+        mod.set_fen(search_fen.encode())
+        mod.set_movegen(b"search")
+        first = best_move(mod)
+        assert best_move(mod) == first
+        assert get_position_cache_stats(mod)["best_move_hits"] == 1
+
+        # a change of engine settings means asking the generator again
+        mod.set_movegen(b"search")
+        best_move(mod)
+        assert get_position_cache_stats(mod)["best_move_hits"] == 1
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+
+
+def test_position_cache_skips_random_moves():
+    # random picks are asked for afresh every time
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(default_fen.encode())
+    mod.set_movegen(b"random")
+    moves = {best_move(mod) for _ in range(20)}
+    assert len(moves) > 1
+    assert get_position_cache_stats(mod)["best_move_hits"] == 0
+
+
+def test_position_cache_disabled():
+    mod = load_library()
+    mod.init_game(8, 8)
+    assert mod.set_position_cache_size(0)
+    try:
+        for _ in range(2):
+            mod.set_fen(default_fen.encode())
+            assert STATUS(mod.get_status()) == STATUS.ONGOING
+        stats = get_position_cache_stats(mod)
+        assert stats["capacity"] == 0
+        assert stats["hits"] == 0
+        assert stats["misses"] == 0
+    finally:
+        mod.set_position_cache_size(POSCACHE_DEFAULT_ENTRIES)
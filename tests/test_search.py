@@ -0,0 +1,94 @@
+import ctypes
+import pytest
+import threading
+
+from util import load_library, check_expected_move, SEARCH_DEFAULT_TIME_MS
+
+
+best_moves = [
+        ("6k1/5ppp/8/8/8/8/5PPP/R5K1 w", "a1a8"),
+        ("4k3/8/8/3q4/8/8/8/3RK3 w", "d1d5"),
+        ("r5k1/5ppp/8/8/8/8/5PPP/6K1 b", "a8a1"),
+        ("k7/8/1K6/8/8/8/8/7Q w", "h1h8"),
+    ]
+
+
+@pytest.mark.parametrize("fen,expected", best_moves)
+def test_search_best_move(fen, expected):
+    mod = load_library()
+    mod.set_search_limits(3, 0, 0)
+    try:
+        check_expected_move("search", fen, expected)
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+
+
+def test_search_node_budget():
+    mod = load_library()
+    mod.set_search_limits(0, 0, 2000)
+    try:
+        check_expected_move("search", "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w")
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+
+
+def test_search_stop():
+    mod = load_library()
+    # unbounded, so only the stop request can end it
+    mod.set_search_limits(0, 0, 0)
+    timer = threading.Timer(0.2, mod.stop_search)
+    timer.start()
+    try:
+        check_expected_move("search", "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w")
+    finally:
+        timer.cancel()
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+
+
+@pytest.mark.parametrize("fen,expected", best_moves)
+def test_search_threads(fen, expected):
+    mod = load_library()
+    mod.set_search_threads(4)
+    mod.set_search_limits(4, 0, 0)
+    try:
+        check_expected_move("search", fen, expected)
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+        mod.set_search_threads(1)
+
+
+# white is lost, a rook and king against a queen, and would rather draw
+# than win back the knight
+lost_fen = "k2q4/8/8/8/8/8/8/nR5K w - - {} 80"
+
+
+def search_after(fen, moves):
+    mod = load_library()
+    mod.init_game(8, 8)
+    mod.set_fen(fen.encode())
+    mod.set_movegen(b"search")
+    for uci in moves.split():
+        assert mod.apply_move_uci(uci.encode()), uci
+    max_len = 10
+    uci = (ctypes.c_char * max_len)()
+    assert mod.get_best_move(uci, max_len)
+    return uci.value.decode()
+
+
+def test_search_claims_repetition():
+    mod = load_library()
+    mod.set_search_limits(3, 0, 0)
+    try:
+        assert search_after(lost_fen.format(0), "") == "b1a1"
+        assert search_after(lost_fen.format(0), "h1g1 d8d7 g1h1 d7d8") == "h1g1"
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+
+
+def test_search_claims_fifty_moves():
+    mod = load_library()
+    mod.set_search_limits(3, 0, 0)
+    try:
+        assert search_after(lost_fen.format(99), "") != "b1a1"
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
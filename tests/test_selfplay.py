@@ -0,0 +1,50 @@
+import ctypes
+
+from util import load_library, default_fen, STATUS
+
+
+def load_handles():
+    mod = load_library()
+    mod.create_game.restype = ctypes.c_void_p
+    mod.destroy_game.argtypes = [ctypes.c_void_p]
+    mod.set_game_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    mod.set_game_seed.argtypes = [ctypes.c_void_p, ctypes.c_uint]
+    mod.get_game_status.argtypes = [ctypes.c_void_p]
+    mod.apply_game_move_uci.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    mod.apply_game_move_uci.restype = ctypes.c_bool
+    mod.get_game_best_move.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+    return mod
+
+
+def play_game(mod, seed, plies=40):
+    # the way selfplay plays one, both sides from the same generator
+    game = mod.create_game(8, 8)
+    try:
+        mod.set_game_fen(game, default_fen.encode())
+        mod.set_game_seed(game, seed)
+        moves = []
+        max_len = 10
+        uci = (ctypes.c_char * max_len)()
+        for _ in range(plies):
+            if STATUS(mod.get_game_status(game)) not in (STATUS.ONGOING, STATUS.CHECK):
+                break
+            assert mod.get_game_best_move(game, uci, max_len)
+            assert mod.apply_game_move_uci(game, uci.value)
+            moves.append(uci.value.decode())
+        return moves
+    finally:
+        mod.destroy_game(game)
+
+
+def test_seed_replays_game():
+    mod = load_handles()
+    for movegen in (b"random", b"fav_colour"):
+        mod.set_movegen(movegen)
+        assert play_game(mod, 1) == play_game(mod, 1)
+
+
+def test_seeds_give_different_games():
+    mod = load_handles()
+    for movegen in (b"random", b"fav_colour"):
+        mod.set_movegen(movegen)
+        assert play_game(mod, 1) != play_game(mod, 2)
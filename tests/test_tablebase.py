@@ -0,0 +1,71 @@
+import ctypes
+import os
+import pytest
+
+from util import load_library, check_expected_move, STATUS
+
+
+TB_DIR = os.path.join(os.getenv("BUILD_TESTS_DIR", "build/tests"), "tb")
+
+
+class WDL:
+    DRAW = 0
+    WIN = 1
+    LOSS = 2
+
+
+@pytest.fixture
+def tables():
+    mod = load_library()
+    assert mod.open_tablebases(TB_DIR.encode()) == 5
+    yield mod
+    mod.close_tablebases()
+
+
+def probe(mod, fen):
+    mod.init_game(8, 8)
+    mod.set_fen(fen.encode())
+    dtm = ctypes.c_int(-1)
+    wdl = mod.probe_tablebase(ctypes.byref(dtm))
+    return wdl, dtm.value
+
+
+probes = [
+        ("8/8/8/4k3/8/8/8/4K2Q w", WDL.WIN, None),
+        ("8/8/8/4k3/8/8/8/4K2Q b", WDL.LOSS, None),
+        ("k7/8/1K6/8/8/8/8/6Q1 w", WDL.WIN, 1),
+        ("k7/8/1K6/8/8/8/8/7R w", WDL.WIN, 1),
+        ("8/8/8/8/8/3k4/3P4/7K b", WDL.DRAW, 0),
+        ("8/8/8/8/8/3k4/3B4/7K w", WDL.DRAW, 0),
+    ]
+
+
+@pytest.mark.parametrize("fen,wdl,dtm", probes)
+def test_tablebase_probe(tables, fen, wdl, dtm):
+    got_wdl, got_dtm = probe(tables, fen)
+    assert got_wdl == wdl
+    if dtm is not None:
+        assert got_dtm == dtm
+
+
+def test_tablebase_mirrored_colours(tables):
+    # black's queen is looked up in the white queen table
+    assert probe(tables, "6q1/8/8/8/4K3/8/8/4k3 b")[0] == WDL.WIN
+    assert probe(tables, "6q1/8/8/8/4K3/8/8/4k3 w")[0] == WDL.LOSS
+
+
+def test_tablebase_not_covered(tables):
+    assert probe(tables, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w")[0] == -1
+
+
+def test_tablebase_mates(tables):
+    # random would rarely find it, the tables always do
+    mod = tables
+    check_expected_move("random", "k7/8/1K6/8/8/8/8/7R w", "h1h8")
+    mod.apply_move_uci(b"h1h8")
+    assert STATUS(mod.get_status()) == STATUS.CHECKMATE
+
+
+def test_tablebase_missing_dir():
+    mod = load_library()
+    assert mod.open_tablebases(b"/nonexistent") == 0
@@ -0,0 +1,46 @@
+import ctypes
+
+from util import load_library, check_expected_move, SEARCH_DEFAULT_TIME_MS
+
+
+TT_DEFAULT_SIZE_MB = 4
+STATS_LEN = 6
+
+
+def get_hash_stats(mod):
+    stats = (ctypes.c_double * STATS_LEN)()
+    assert mod.get_hash_stats(stats, STATS_LEN) == STATS_LEN
+    size_mb, entries, used, hits, misses, stores = stats
+    return dict(size_mb=size_mb, entries=entries, used=used, hits=hits, misses=misses, stores=stores)
+
+
+def test_tt_hits_during_search():
+    mod = load_library()
+    assert mod.set_hash_size(1)
+    mod.set_search_limits(4, 0, 0)
+    try:
+        check_expected_move("search", "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w")
+        stats = get_hash_stats(mod)
+        assert stats["size_mb"] == 1
+        assert stats["entries"] > 0
+        assert 0 < stats["used"] <= stats["entries"]
+        assert stats["hits"] > 0
+        assert stats["misses"] > 0
+        assert stats["stores"] >= stats["used"]
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+        mod.set_hash_size(TT_DEFAULT_SIZE_MB)
+
+
+def test_tt_disabled():
+    mod = load_library()
+    assert mod.set_hash_size(0)
+    mod.set_search_limits(3, 0, 0)
+    try:
+        check_expected_move("search", "6k1/5ppp/8/8/8/8/5PPP/R5K1 w", "a1a8")
+        stats = get_hash_stats(mod)
+        assert stats["entries"] == 0
+        assert stats["hits"] == 0
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+        mod.set_hash_size(TT_DEFAULT_SIZE_MB)
@@ -0,0 +1,90 @@
+import ctypes
+import json
+import os
+import shutil
+import subprocess
+
+import pytest
+
+from util import load_library, SEARCH_DEFAULT_TIME_MS
+
+
+BRIDGE_PATH = os.path.join(os.path.dirname(__file__), "..", "static_resources", "wasm", "wasm_bridge.js")
+
+# white is lost and would rather repeat than win back the knight
+lost_fen = "k2q4/8/8/8/8/8/8/nR5K w - - 0 80"
+shuffle = "h1g1 d8d7 g1h1 d7d8"
+
+# records what the bridge would send the worker before a search
+replay_script = """
+import { MoveHistory } from %s;
+const { fen, played } = JSON.parse(process.argv[1]);
+const history = new MoveHistory();
+history.reset(fen);
+for (const [uci, after] of played)
+    history.played(uci, after);
+const calls = [];
+history.sendTo({ call: (method, ...args) => calls.push([method, ...args]) });
+console.log(JSON.stringify(calls));
+"""
+
+
+def full_fen(mod):
+    max_len = 128
+    fen = (ctypes.c_char * max_len)()
+    assert mod.get_full_fen(fen, max_len) > 0
+    return fen.value.decode()
+
+
+def bridge_calls(fen, played):
+    script = replay_script % json.dumps("file://" + os.path.abspath(BRIDGE_PATH))
+    out = subprocess.run(["node", "--input-type=module", "-e", script, json.dumps(dict(fen=fen, played=played))],
+            check=True, capture_output=True, text=True).stdout
+    return json.loads(out)
+
+
+@pytest.mark.skipif(shutil.which("node") is None, reason="needs node")
+def test_worker_sees_repetition():
+    mod = load_library()
+    mod.apply_move_uci.restype = ctypes.c_bool
+    mod.init_game(8, 8)
+    assert mod.set_fen(lost_fen.encode())
+    start = full_fen(mod)
+    played = []
+    for uci in shuffle.split():
+        assert mod.apply_move_uci(uci.encode())
+        played.append((uci, full_fen(mod)))
+    calls = bridge_calls(start, played)
+    assert calls == [["setFEN", start]] + [["applyMove", uci] for uci in shuffle.split()]
+
+    # the worker's own game, set up from those calls, claims the draw
+    mod.set_search_limits(3, 0, 0)
+    try:
+        mod.init_game(8, 8)
+        mod.set_movegen(b"search")
+        for method, arg in calls:
+            if method == "setFEN":
+                assert mod.set_fen(arg.encode())
+            else:
+                assert mod.apply_move_uci(arg.encode())
+        max_len = 10
+        uci = (ctypes.c_char * max_len)()
+        assert mod.get_best_move(uci, max_len)
+        assert uci.value == b"h1g1"
+    finally:
+        mod.set_search_limits(0, SEARCH_DEFAULT_TIME_MS, 0)
+
+
+@pytest.mark.skipif(shutil.which("node") is None, reason="needs node")
+def test_worker_history_starts_after_capture():
+    mod = load_library()
+    mod.apply_move_uci.restype = ctypes.c_bool
+    mod.init_game(8, 8)
+    assert mod.set_fen(lost_fen.encode())
+    start = full_fen(mod)
+    played = []
+    for uci in "b1a1 a8b8 h1g1".split():
+        assert mod.apply_move_uci(uci.encode())
+        played.append((uci, full_fen(mod)))
+    calls = bridge_calls(start, played)
+    assert calls == [["setFEN", played[0][1]], ["applyMove", "a8b8"], ["applyMove", "h1g1"]]
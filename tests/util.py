@@ -7,12 +7,16 @@ default_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w"
 fools_mate_fen = "rnb1kbnr/pppp1ppp/4p3/8/6Pq/5P2/PPPPP2P/RNBQKBNR w"
 scholars_mate_fen = "r1bqkb1r/pppp1Qpp/2n2n2/4p3/2B1P3/8/PPPP1PPP/RNB1K1NR b"
 
+SEARCH_DEFAULT_TIME_MS = 250
+
 
 class STATUS(enum.Enum):
     ONGOING = 0
     CHECK = 1
     CHECKMATE = 2
     STALEMATE = 3
+    REPETITION = 4
+    FIFTY_MOVES = 5
 
 
 def load_library():
@@ -46,3 +50,56 @@ def check_status(fen):
 
     status_enum = mod.get_status()
     return STATUS(status_enum)
+
+
+KNIGHT_STEPS = ((1, 2), (2, 1), (2, -1), (1, -2), (-1, -2), (-2, -1), (-2, 1), (-1, 2))
+KING_STEPS = ((1, 0), (1, 1), (0, 1), (-1, 1), (-1, 0), (-1, -1), (0, -1), (1, -1))
+ROOK_DIRECTIONS = ((1, 0), (0, 1), (-1, 0), (0, -1))
+BISHOP_DIRECTIONS = ((1, 1), (-1, 1), (-1, -1), (1, -1))
+
+
+# pieces of a FEN as one letter per square ('' when empty), indexed from a8
+# like the engine
+def fen_squares(fen, width):
+    squares = []
+    digits = ""
+    for c in fen.split()[0]:
+        if c.isdigit():
+            digits += c
+            continue
+        if digits:
+            squares += [""] * int(digits)
+            digits = ""
+        if c != "/":
+            squares.append(c)
+    if digits:
+        squares += [""] * int(digits)
+    assert len(squares) % width == 0, "ranks of the wrong width"
+    return squares
+
+
+def steps_from(index, steps, width, height):
+    x, y = index % width, index // width
+    for dx, dy in steps:
+        if 0 <= x + dx < width and 0 <= y + dy < height:
+            yield (y + dy) * width + x + dx
+
+
+# pieces of one colour attacking a square, only the first along each ray
+def count_attackers(squares, width, height, index, white):
+    def own(c, letter):
+        return c == (letter.upper() if white else letter)
+
+    # a white pawn takes towards a8, so it attacks from the rank below
+    pawn_dy = 1 if white else -1
+    count = sum(own(squares[sq], "p") for sq in steps_from(index, ((-1, pawn_dy), (1, pawn_dy)), width, height))
+    count += sum(own(squares[sq], "n") for sq in steps_from(index, KNIGHT_STEPS, width, height))
+    count += sum(own(squares[sq], "k") for sq in steps_from(index, KING_STEPS, width, height))
+    for directions, slider in ((ROOK_DIRECTIONS, "r"), (BISHOP_DIRECTIONS, "b")):
+        for dx, dy in directions:
+            x, y = index % width + dx, index // width + dy
+            while 0 <= x < width and 0 <= y < height and not squares[y * width + x]:
+                x, y = x + dx, y + dy
+            if 0 <= x < width and 0 <= y < height:
+                count += own(squares[y * width + x], slider) or own(squares[y * width + x], "q")
+    return count
@@ -0,0 +1,97 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "book.h"
+#include "movegen.h"
+#include "tb.h"
+#include "util.h"
+
+#include "movegen/search.h"
+
+
+#define DEFAULT_MOVEGEN         "search"
+#define DEFAULT_MOVE_TIME_MS    50
+
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [-j threads] [-m movegen] [-t ms per position] [-d search depth]\n"
+        "       %*s [-b book] [-e tablebase dir] [in.epd [out.epd]]\n",
+        prog, (int)strlen(prog), "");
+    exit(EXIT_FAILURE);
+}
+
+
+int main(int argc, char** argv)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cores > 0 ? (int)cores : 1;
+    const char* movegen = DEFAULT_MOVEGEN;
+    int move_time_ms = DEFAULT_MOVE_TIME_MS;
+    int search_depth = 0;
+    const char* book_path = NULL;
+    const char* tb_dir = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:m:t:d:b:e:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j': threads = atoi(optarg); break;
+            case 'm': movegen = optarg; break;
+            case 't': move_time_ms = atoi(optarg); break;
+            case 'd': search_depth = atoi(optarg); break;
+            case 'b': book_path = optarg; break;
+            case 'e': tb_dir = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (argc - optind > 2 || threads < 1)
+        usage(argv[0]);
+    if (!movegen_set(movegen))
+        raise_error(EINVAL, "no movegen called '%s'", movegen); /* exits here */
+    if (book_path && !book_open(book_path))
+        raise_error(EINVAL, "could not open book '%s'", book_path); /* exits here */
+    if (tb_dir && !tb_open(tb_dir))
+        raise_error(ENOENT, "no endgame tables in '%s'", tb_dir); /* exits here */
+    search_limits_t limits;
+    movegen_search_default_limits(&limits);
+    movegen_search_set_limits(&limits, search_depth, move_time_ms, 0);
+
+    /* stdin and stdout by default, so it sits in a pipeline */
+    FILE* in = stdin;
+    FILE* out = stdout;
+    if (argc - optind >= 1 && strcmp(argv[optind], "-"))
+    {
+        in = fopen(argv[optind], "r");
+        if (!in)
+            raise_error(errno, "could not open '%s'", argv[optind]); /* exits here */
+    }
+    if (argc - optind == 2 && strcmp(argv[optind + 1], "-"))
+    {
+        out = fopen(argv[optind + 1], "w");
+        if (!out)
+            raise_error(errno, "could not create '%s'", argv[optind + 1]); /* exits here */
+    }
+
+    batch_stats_t stats;
+    if (!batch_analyse(in, out, threads, &limits, &stats))
+        raise_error(EIO, "analysis failed"); /* exits here */
+    if (in != stdin)
+        fclose(in);
+    if (out != stdout && fclose(out))
+        raise_error(errno, "could not write '%s'", argv[optind + 1]); /* exits here */
+
+    double seconds = (double)stats.elapsed_us / 1000000.0;
+    fprintf(stderr, "%ld positions, %ld invalid, %.3fs, %.1f positions/s\n",
+        stats.positions, stats.invalid, seconds, seconds > 0.0 ? stats.positions / seconds : 0.0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,434 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "fen.h"
+#include "game.h"
+#include "move.h"
+#include "movegen.h"
+#include "rules.h"
+#include "tt.h"
+#include "util.h"
+
+#include "movegen/search.h"
+
+
+#define BENCH_MAX_BENCHMARKS    32
+#define BENCH_NAME_LEN          64
+#define BENCH_LINE_LEN          256
+#define BENCH_FEN_LEN           128
+#define BENCH_MAX_MOVEGENS      16
+#define BENCH_SEARCH_DEPTH      3
+#define DEFAULT_ROUND_MS        100
+#define DEFAULT_ROUNDS          5
+#define DEFAULT_THRESHOLD       10.0
+
+
+/* fixed so results stay comparable from one run to the next: the opening,
+ * a busy middlegame, a pawn ending, promotions and pins, and a quiet
+ * middlegame */
+static const char* const fens[] =
+{
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w",
+};
+#define POSITION_COUNT          ((int)(sizeof(fens) / sizeof(fens[0])))
+
+
+typedef struct
+{
+    board_t* board;
+    colour_t turn;
+    game_t* game;
+} position_t;
+
+/* one pass over every position, returning how many operations it ran */
+typedef uint64_t (*pass_fn_t)(const movegen_t* movegen);
+
+typedef struct
+{
+    char name[BENCH_NAME_LEN];
+    pass_fn_t pass;
+    const movegen_t* movegen;
+    uint64_t ops;
+    double ns_per_op;
+} benchmark_t;
+
+typedef struct
+{
+    char name[BENCH_NAME_LEN];
+    double ns_per_op;
+} baseline_t;
+
+
+static position_t positions[POSITION_COUNT];
+static volatile uint64_t sink;      /* keeps results from being optimised away */
+
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [-t ms per round] [-r rounds] [-f filter] [-o results.json]\n"
+        "       %*s [-b baseline.json] [-x regression threshold %%]\n",
+        prog, (int)strlen(prog), "");
+    exit(EXIT_FAILURE);
+}
+
+
+static uint64_t pass_parse_fen(const movegen_t* movegen)
+{
+    for (int i = 0; i < POSITION_COUNT; i++)
+    {
+        colour_t turn = COLOUR_WHITE;
+        board_t* board = parse_fen(fens[i], &turn);
+        sink += board->hash;
+        destroy_board(board);
+    }
+    return POSITION_COUNT;
+}
+
+
+static uint64_t pass_generate_fen(const movegen_t* movegen)
+{
+    char fen[BENCH_FEN_LEN];
+    for (int i = 0; i < POSITION_COUNT; i++)
+        sink += generate_fen(positions[i].board, positions[i].turn, fen, sizeof(fen));
+    return POSITION_COUNT;
+}
+
+
+static uint64_t pass_fen_parse(const movegen_t* movegen)
+{
+    /* into the positions' own boards, which it leaves as they were */
+    fen_state_t state;
+    for (int i = 0; i < POSITION_COUNT; i++)
+        sink += fen_parse(positions[i].board, fens[i], &state);
+    return POSITION_COUNT;
+}
+
+
+static uint64_t pass_fen_write(const movegen_t* movegen)
+{
+    char fen[BENCH_FEN_LEN];
+    fen_state_t state;
+    for (int i = 0; i < POSITION_COUNT; i++)
+    {
+        fen_state_init(&state, positions[i].turn);
+        sink += fen_write(positions[i].board, &state, fen, sizeof(fen));
+    }
+    return POSITION_COUNT;
+}
+
+
+static uint64_t pass_generate_moves(const movegen_t* movegen)
+{
+    /* once per piece of the side to move */
+    uint64_t ops = 0;
+    move_t moves[MOVE_LIST_CAPACITY];
+    for (int i = 0; i < POSITION_COUNT; i++)
+    {
+        board_t* board = positions[i].board;
+        for (int sq = find_next_piece(board, positions[i].turn, 0); sq >= 0; sq = find_next_piece(board, positions[i].turn, sq + 1))
+        {
+            sink += generate_moves(board, sq, moves, MOVE_LIST_CAPACITY);
+            ops++;
+        }
+    }
+    return ops;
+}
+
+
+static uint64_t pass_generate_all_moves(const movegen_t* movegen)
+{
+    move_list_t list;
+    for (int i = 0; i < POSITION_COUNT; i++)
+    {
+        generate_all_moves(positions[i].board, positions[i].turn, &list);
+        sink += list.count;
+    }
+    return POSITION_COUNT;
+}
+
+
+static uint64_t pass_is_in_check(const movegen_t* movegen)
+{
+    for (int i = 0; i < POSITION_COUNT; i++)
+        sink += is_in_check(positions[i].board, positions[i].turn);
+    return POSITION_COUNT;
+}
+
+
+static uint64_t pass_has_legal_moves(const movegen_t* movegen)
+{
+    for (int i = 0; i < POSITION_COUNT; i++)
+        sink += has_legal_moves(positions[i].board, positions[i].turn);
+    return POSITION_COUNT;
+}
+
+
+static uint64_t pass_movegen(const movegen_t* movegen)
+{
+    for (int i = 0; i < POSITION_COUNT; i++)
+    {
+        game_t* game = positions[i].game;
+        move_t m = move_encode(0, 0, PIECE_TYPE_EMPTY, MOVE_FLAG_NONE);
+        game_history_t history;
+        game_get_history(game, &history);
+        movegen->generator(&game->config, game->board, game->turn, game_get_legal_moves(game),
+            game_get_scratch(game), &m, game_get_status(game), &history);
+        sink += m.to;
+    }
+    return POSITION_COUNT;
+}
+
+
+static void add_benchmark(benchmark_t* list, int* count, const char* name, pass_fn_t pass, const movegen_t* movegen)
+{
+    if (*count >= BENCH_MAX_BENCHMARKS)
+        raise_error(E2BIG, "more than %d benchmarks", BENCH_MAX_BENCHMARKS); /* exits here */
+    benchmark_t* b = &list[(*count)++];
+    memset(b, 0, sizeof(*b));
+    snprintf(b->name, sizeof(b->name), "%s", name);
+    b->pass = pass;
+    b->movegen = movegen;
+}
+
+
+static int collect_benchmarks(benchmark_t* list)
+{
+    int count = 0;
+    add_benchmark(list, &count, "parse_fen", pass_parse_fen, NULL);
+    add_benchmark(list, &count, "generate_fen", pass_generate_fen, NULL);
+    add_benchmark(list, &count, "fen_parse", pass_fen_parse, NULL);
+    add_benchmark(list, &count, "fen_write", pass_fen_write, NULL);
+    add_benchmark(list, &count, "generate_moves", pass_generate_moves, NULL);
+    add_benchmark(list, &count, "generate_all_moves", pass_generate_all_moves, NULL);
+    add_benchmark(list, &count, "is_in_check", pass_is_in_check, NULL);
+    add_benchmark(list, &count, "has_legal_moves", pass_has_legal_moves, NULL);
+
+    char names[BENCH_MAX_MOVEGENS][BENCH_NAME_LEN];
+    char* rows[BENCH_MAX_MOVEGENS];
+    for (int i = 0; i < BENCH_MAX_MOVEGENS; i++)
+        rows[i] = names[i];
+    int movegens = movegen_list(rows, BENCH_MAX_MOVEGENS, BENCH_NAME_LEN);
+    for (int i = 0; i < movegens; i++)
+    {
+        char name[BENCH_NAME_LEN];
+        names[i][BENCH_NAME_LEN - 1] = '\0';
+        snprintf(name, sizeof(name), "movegen_%s", names[i]);
+        add_benchmark(list, &count, name, pass_movegen, movegen_find(names[i]));
+    }
+    return count;
+}
+
+
+static void run_benchmark(benchmark_t* b, int rounds, uint64_t round_us)
+{
+    /* each round repeats passes for at least round_us, the fastest round
+     * is the one reported as it has the least noise in it */
+    b->pass(b->movegen);
+    b->ns_per_op = 0.0;
+    for (int r = 0; r < rounds; r++)
+    {
+        uint64_t ops = 0;
+        uint64_t start = monotonic_us();
+        uint64_t elapsed = 0;
+        do
+        {
+            ops += b->pass(b->movegen);
+            elapsed = monotonic_us() - start;
+        } while (elapsed < round_us);
+        double ns = (double)elapsed * 1000.0 / (double)ops;
+        if (r == 0 || ns < b->ns_per_op)
+        {
+            b->ns_per_op = ns;
+            b->ops = ops;
+        }
+    }
+}
+
+
+static void write_results(FILE* f, const benchmark_t* list, int count)
+{
+    /* one benchmark per line, which is all read_baseline relies on */
+    fprintf(f, "{\n  \"positions\": %d,\n  \"benchmarks\": [\n", POSITION_COUNT);
+    for (int i = 0; i < count; i++)
+    {
+        const benchmark_t* b = &list[i];
+        fprintf(f, "    {\"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.1f, \"ops_per_s\": %.0f}%s\n",
+            b->name, (unsigned long long)b->ops, b->ns_per_op, 1e9 / b->ns_per_op, i + 1 < count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+
+static int read_baseline(const char* path, baseline_t* baseline)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        raise_error(errno, "could not open baseline '%s'", path); /* exits here */
+    char line[BENCH_LINE_LEN];
+    int count = 0;
+    while (fgets(line, sizeof(line), f) && count < BENCH_MAX_BENCHMARKS)
+    {
+        const char* name = strstr(line, "\"name\": \"");
+        const char* ns = strstr(line, "\"ns_per_op\": ");
+        if (!name || !ns)
+            continue;
+        name += strlen("\"name\": \"");
+        size_t len = strcspn(name, "\"");
+        if (len >= BENCH_NAME_LEN)
+            continue;
+        memcpy(baseline[count].name, name, len);
+        baseline[count].name[len] = '\0';
+        baseline[count].ns_per_op = strtod(ns + strlen("\"ns_per_op\": "), NULL);
+        count++;
+    }
+    fclose(f);
+    if (!count)
+        raise_error(EINVAL, "no results in baseline '%s'", path); /* exits here */
+    return count;
+}
+
+
+static const baseline_t* find_baseline(const baseline_t* baseline, int count, const char* name)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!strcmp(baseline[i].name, name))
+            return &baseline[i];
+    }
+    return NULL;
+}
+
+
+static int report(const benchmark_t* list, int count, const baseline_t* baseline, int baseline_count, double threshold)
+{
+    /* returns how many benchmarks got slower than the threshold allows */
+    int regressions = 0;
+    fprintf(stderr, "%-22s %12s %14s", "benchmark", "ns/op", "ops/s");
+    if (baseline)
+        fprintf(stderr, " %12s %9s", "baseline", "change");
+    fprintf(stderr, "\n");
+    for (int i = 0; i < count; i++)
+    {
+        const benchmark_t* b = &list[i];
+        fprintf(stderr, "%-22s %12.1f %14.0f", b->name, b->ns_per_op, 1e9 / b->ns_per_op);
+        const baseline_t* base = baseline ? find_baseline(baseline, baseline_count, b->name) : NULL;
+        if (base && base->ns_per_op > 0.0)
+        {
+            double change = (b->ns_per_op / base->ns_per_op - 1.0) * 100.0;
+            bool regressed = change > threshold;
+            regressions += regressed;
+            fprintf(stderr, " %12.1f %+8.1f%%%s", base->ns_per_op, change, regressed ? "  REGRESSION" : "");
+        }
+        else if (baseline)
+        {
+            fprintf(stderr, " %12s", "new");
+        }
+        fprintf(stderr, "\n");
+    }
+    if (baseline)
+        fprintf(stderr, "\n%d regression%s over %.1f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    return regressions;
+}
+
+
+static void setup_positions(void)
+{
+    /* every search does the same work with a fixed depth */
+    game_config_t cfg = {8, 8, true, true, true};
+    movegen_search_default_limits(&cfg.search);
+    movegen_search_set_limits(&cfg.search, BENCH_SEARCH_DEPTH, 0, 0);
+    for (int i = 0; i < POSITION_COUNT; i++)
+    {
+        position_t* p = &positions[i];
+        p->turn = COLOUR_WHITE;
+        p->board = parse_fen(fens[i], &p->turn);
+        p->game = game_create(&cfg);
+        game_set_board(p->game, p->board, p->turn);
+    }
+}
+
+
+static void free_positions(void)
+{
+    for (int i = 0; i < POSITION_COUNT; i++)
+    {
+        destroy_board(positions[i].board);
+        game_destroy(positions[i].game);
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    int round_ms = DEFAULT_ROUND_MS;
+    int rounds = DEFAULT_ROUNDS;
+    double threshold = DEFAULT_THRESHOLD;
+    const char* filter = NULL;
+    const char* out_path = NULL;
+    const char* baseline_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:r:f:o:b:x:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't': round_ms = atoi(optarg); break;
+            case 'r': rounds = atoi(optarg); break;
+            case 'f': filter = optarg; break;
+            case 'o': out_path = optarg; break;
+            case 'b': baseline_path = optarg; break;
+            case 'x': threshold = atof(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || round_ms < 1 || rounds < 1)
+        usage(argv[0]);
+
+    static baseline_t baseline[BENCH_MAX_BENCHMARKS];
+    int baseline_count = baseline_path ? read_baseline(baseline_path, baseline) : 0;
+
+    /* and no table to remember earlier passes by */
+    tt_resize(0);
+    setup_positions();
+
+    static benchmark_t all[BENCH_MAX_BENCHMARKS];
+    benchmark_t run[BENCH_MAX_BENCHMARKS];
+    int total = collect_benchmarks(all);
+    int count = 0;
+    for (int i = 0; i < total; i++)
+    {
+        if (filter && !strstr(all[i].name, filter))
+            continue;
+        run_benchmark(&all[i], rounds, (uint64_t)round_ms * 1000u);
+        run[count++] = all[i];
+    }
+    free_positions();
+
+    FILE* out = stdout;
+    if (out_path)
+    {
+        out = fopen(out_path, "w");
+        if (!out)
+            raise_error(errno, "could not create '%s'", out_path); /* exits here */
+    }
+    write_results(out, run, count);
+    if (out != stdout && fclose(out))
+        raise_error(errno, "could not write '%s'", out_path); /* exits here */
+
+    int regressions = report(run, count, baseline_path ? baseline : NULL, baseline_count, threshold);
+    return regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "book.h"
+#include "fen.h"
+#include "move.h"
+#include "rules.h"
+#include "util.h"
+#include "zobrist.h"
+
+
+#define START_FEN               "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w"
+#define BOOK_LINE_LEN           4096
+#define BOOK_MAX_WEIGHT         0xffffu
+
+
+typedef struct
+{
+    uint64_t key;
+    int from;
+    int to;
+    int promotion;
+    unsigned weight;
+} book_entry_t;
+
+typedef struct
+{
+    book_entry_t* entries;
+    size_t count;
+    size_t capacity;
+} book_builder_t;
+
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s <lines.txt> <book.bin>\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+
+static void add_entry(book_builder_t* book, uint64_t key, const move_t* m)
+{
+    if (book->count == book->capacity)
+    {
+        size_t capacity = book->capacity ? book->capacity * 2 : 1024;
+        book_entry_t* entries = realloc(book->entries, capacity * sizeof(book_entry_t));
+        if (!entries)
+            raise_error(ENOMEM, "failed to grow book"); /* exits here */
+        book->entries = entries;
+        book->capacity = capacity;
+    }
+    book_entry_t e = { key, m->from, m->to, m->promotion, 1 };
+    book->entries[book->count++] = e;
+}
+
+
+static bool add_line(book_builder_t* book, char* line, int line_no)
+{
+    /* a line of uci moves from the start position, every position along it
+     * gets the move played from it */
+    colour_t turn = COLOUR_WHITE;
+    board_t* board = parse_fen(START_FEN, &turn);
+    board->hash = zobrist_hash(board, turn);
+    bool ok = true;
+    for (char* uci = strtok(line, " \t"); uci; uci = strtok(NULL, " \t"))
+    {
+        move_t wanted = uci_to_move(board, uci);
+        move_list_t legal;
+        generate_all_moves(board, turn, &legal);
+        const move_t* m = NULL;
+        for (int i = 0; i < legal.count && !m; i++)
+        {
+            if (move_equal(&legal.moves[i], &wanted))
+                m = &legal.moves[i];
+        }
+        if (!m)
+        {
+            fprintf(stderr, "line %d: illegal move '%s'\n", line_no, uci);
+            ok = false;
+            break;
+        }
+        add_entry(book, board->hash, m);
+        undo_t undo;
+        make_move(board, m, &undo);
+        turn = (turn == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+    }
+    destroy_board(board);
+    return ok;
+}
+
+
+static int compare_entries(const void* a, const void* b)
+{
+    const book_entry_t* x = a;
+    const book_entry_t* y = b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    if (x->from != y->from)
+        return x->from - y->from;
+    if (x->to != y->to)
+        return x->to - y->to;
+    return x->promotion - y->promotion;
+}
+
+
+static void merge_entries(book_builder_t* book)
+{
+    /* lines sharing a position and move add up to its weight */
+    qsort(book->entries, book->count, sizeof(book_entry_t), compare_entries);
+    size_t out = 0;
+    for (size_t i = 0; i < book->count; i++)
+    {
+        if (out && !compare_entries(&book->entries[out - 1], &book->entries[i]))
+        {
+            book_entry_t* e = &book->entries[out - 1];
+            if (e->weight < BOOK_MAX_WEIGHT)
+                e->weight++;
+            continue;
+        }
+        book->entries[out++] = book->entries[i];
+    }
+    book->count = out;
+}
+
+
+static void put_le(unsigned char* p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++, v >>= 8)
+        p[i] = (unsigned char)v;
+}
+
+
+static void write_book(const book_builder_t* book, const char* path)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f)
+        raise_error(errno, "could not create book '%s'", path); /* exits here */
+    unsigned char header[BOOK_HEADER_SIZE] = {0};
+    memcpy(header, BOOK_MAGIC, strlen(BOOK_MAGIC));
+    put_le(header + strlen(BOOK_MAGIC), book->count, 4);
+    fwrite(header, sizeof(header), 1, f);
+    for (size_t i = 0; i < book->count; i++)
+    {
+        const book_entry_t* e = &book->entries[i];
+        unsigned char raw[BOOK_ENTRY_SIZE] = {0};
+        put_le(raw, e->key, 8);
+        put_le(raw + 8, (uint64_t)e->from, 2);
+        put_le(raw + 10, (uint64_t)e->to, 2);
+        raw[12] = (unsigned char)e->promotion;
+        put_le(raw + 14, e->weight, 2);
+        fwrite(raw, sizeof(raw), 1, f);
+    }
+    if (fclose(f))
+        raise_error(errno, "could not write book '%s'", path); /* exits here */
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+        usage(argv[0]);
+    FILE* f = fopen(argv[1], "r");
+    if (!f)
+        raise_error(errno, "could not open '%s'", argv[1]); /* exits here */
+
+    book_builder_t book = { NULL, 0, 0 };
+    char line[BOOK_LINE_LEN];
+    int line_no = 0;
+    int failures = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        line_no++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (!add_line(&book, line, line_no))
+            failures++;
+    }
+    fclose(f);
+    if (failures)
+        raise_error(EINVAL, "%d bad line%s in '%s'", failures, failures == 1 ? "" : "s", argv[1]); /* exits here */
+
+    merge_entries(&book);
+    write_book(&book, argv[2]);
+    printf("%zu book entries from %d lines\n", book.count, line_no);
+    free(book.entries);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,603 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "move.h"
+#include "rules.h"
+#include "tb.h"
+#include "util.h"
+
+
+#define MAX_WORKERS             256
+#define TB_PATH_LEN             1024
+#define TB_SQUARES              (TB_BOARD_SIZE * TB_BOARD_SIZE)
+#define MAX_RELATIVES           128     /* distinct positions one move away */
+#define WRITE_CHUNK             65536   /* cells converted and written at a time */
+
+/* working values, in plies: 0 unknown, wins 1-127, losses 128 + plies */
+#define VALUE_UNKNOWN           0
+#define VALUE_LOSS_BASE         128
+#define VALUE_DRAWN             254
+#define VALUE_ILLEGAL           255
+#define MAX_PLIES               124     /* keeps moves to mate in 6 bits */
+
+#define IS_WIN(v)               ((v) >= 1 && (v) < VALUE_LOSS_BASE)
+#define IS_LOSS(v)              ((v) >= VALUE_LOSS_BASE && (v) < VALUE_DRAWN)
+
+
+typedef struct
+{
+    char signature[TB_SIGNATURE_LEN];
+    uint64_t positions;
+    _Atomic uint8_t* values;
+    _Atomic uint8_t* counters;      /* children not yet known to win */
+    uint8_t* exit_wins;             /* ply of a win through capture or promotion */
+    uint8_t* exit_losses;           /* longest loss through capture or promotion */
+    int ply;
+    atomic_int deepest;
+} builder_t;
+
+typedef struct
+{
+    builder_t* builder;
+    uint64_t begin;
+    uint64_t end;
+    pthread_t thread;
+} worker_t;
+
+typedef struct
+{
+    int row;
+    int col;
+} delta_t;
+
+
+static const delta_t king_deltas[] = { {-1,-1}, {-1,0}, {-1,1}, {0,-1}, {0,1}, {1,-1}, {1,0}, {1,1} };
+static const delta_t knight_deltas[] = { {-2,-1}, {-2,1}, {-1,-2}, {-1,2}, {1,-2}, {1,2}, {2,-1}, {2,1} };
+static const delta_t bishop_deltas[] = { {-1,-1}, {-1,1}, {1,-1}, {1,1} };
+static const delta_t rook_deltas[] = { {-1,0}, {0,-1}, {0,1}, {1,0} };
+
+static int worker_count = 1;
+static char built[TB_MAX_TABLES][TB_SIGNATURE_LEN];
+static int built_count = 0;
+
+
+static void usage(const char* prog)
+{
+    fprintf(stderr, "usage: %s [-j threads] <dir> <signature>...\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+
+static colour_t opponent(colour_t colour)
+{
+    return (colour == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+}
+
+
+static void run_workers(builder_t* b, void* (*run)(void*))
+{
+    /* splits the index range evenly, each worker on its own slice */
+    worker_t workers[MAX_WORKERS];
+    for (int i = 0; i < worker_count; i++)
+    {
+        workers[i].builder = b;
+        workers[i].begin = b->positions * i / worker_count;
+        workers[i].end = b->positions * (i + 1) / worker_count;
+        if (pthread_create(&workers[i].thread, NULL, run, &workers[i]))
+            raise_error(EAGAIN, "could not start a worker"); /* exits here */
+    }
+    for (int i = 0; i < worker_count; i++)
+        pthread_join(workers[i].thread, NULL);
+}
+
+
+static void place(board_t* board, const tb_position_t* pos, bool present)
+{
+    piece_t empty = { PIECE_TYPE_EMPTY, COLOUR_NONE };
+    for (int i = 0; i < pos->count; i++)
+        set_piece(board, pos->squares[i], present ? (piece_t*)&pos->pieces[i] : &empty);
+}
+
+
+static bool add_relative(uint64_t* list, int* count, uint64_t index)
+{
+    for (int i = 0; i < *count; i++)
+    {
+        if (list[i] == index)
+            return false;
+    }
+    if (*count >= MAX_RELATIVES)
+        raise_error(E2BIG, "too many positions one move away"); /* exits here */
+    list[(*count)++] = index;
+    return true;
+}
+
+
+static bool child_after(const tb_position_t* pos, const move_t* m, tb_position_t* child)
+{
+    /* true if the move keeps the material, and so the table */
+    *child = *pos;
+    child->turn = opponent(pos->turn);
+    bool same = true;
+    int mover = -1;
+    for (int i = 0; i < child->count; i++)
+    {
+        if (child->squares[i] == m->from)
+            mover = i;
+    }
+    for (int i = 0; i < child->count; i++)
+    {
+        if (child->squares[i] != m->to)
+            continue;
+        child->pieces[i] = child->pieces[child->count - 1];
+        child->squares[i] = child->squares[child->count - 1];
+        if (mover == child->count - 1)
+            mover = i;
+        child->count--;
+        same = false;
+        break;
+    }
+    child->squares[mover] = m->to;
+    if (m->promotion != PIECE_TYPE_EMPTY)
+    {
+        child->pieces[mover].type = (piece_type_t)m->promotion;
+        same = false;
+    }
+    return same;
+}
+
+
+static uint64_t index_of(const tb_position_t* pos)
+{
+    tb_position_t normalised;
+    tb_normalise(pos, &normalised);
+    return tb_index(&normalised);
+}
+
+
+static void init_position(builder_t* b, board_t* board, uint64_t index)
+{
+    /* finds illegal positions, mates and stalemates, probes the smaller
+     * tables for captures and promotions, and counts the distinct positions
+     * reachable inside this table */
+    tb_position_t pos;
+    if (!tb_decode(b->signature, index, &pos) || tb_index(&pos) != index)
+    {
+        atomic_store_explicit(&b->values[index], VALUE_ILLEGAL, memory_order_relaxed);
+        return;
+    }
+    for (int i = 0; i < pos.count; i++)
+    {
+        int row = pos.squares[i] / TB_BOARD_SIZE;
+        if (pos.pieces[i].type == PIECE_TYPE_PAWN && (row == 0 || row == TB_BOARD_SIZE - 1))
+        {
+            atomic_store_explicit(&b->values[index], VALUE_ILLEGAL, memory_order_relaxed);
+            return;
+        }
+    }
+
+    place(board, &pos, true);
+    uint8_t value = VALUE_UNKNOWN;
+    unsigned counter = 0;
+    unsigned exit_win = 0;
+    unsigned exit_loss = 0;
+    if (is_in_check(board, opponent(pos.turn)))
+    {
+        value = VALUE_ILLEGAL;
+    }
+    else
+    {
+        move_list_t list;
+        generate_all_moves(board, pos.turn, &list);
+        uint64_t children[MAX_RELATIVES];
+        int child_count = 0;
+        bool draw_exit = false;
+        int moves = 0;
+        for (int i = 0; i < list.count; i++)
+        {
+            const move_t* m = &list.moves[i];
+            if (m->flags == MOVE_FLAG_CASTLING || m->flags == MOVE_FLAG_EN_PASSANT)
+                continue;
+            moves++;
+            tb_position_t child;
+            if (child_after(&pos, m, &child))
+            {
+                add_relative(children, &child_count, index_of(&child));
+                continue;
+            }
+            tb_result_t r;
+            if (!tb_probe_position(&child, &r))
+                raise_error(ENOENT, "%s needs a table it can't probe", b->signature); /* exits here */
+            if (r.wdl == TB_LOSS && (!exit_win || 2u * r.dtm + 1 < exit_win))
+                exit_win = 2u * r.dtm + 1;
+            else if (r.wdl == TB_WIN && 2u * r.dtm > exit_loss)
+                exit_loss = 2u * r.dtm;
+            else if (r.wdl == TB_DRAW)
+                draw_exit = true;
+        }
+        /* a drawing exit means this position can never be lost */
+        counter = (unsigned)child_count + (draw_exit ? 1 : 0);
+        if (!moves)
+            value = is_in_check(board, pos.turn) ? VALUE_LOSS_BASE : VALUE_DRAWN;
+        else if (!counter)
+            value = exit_win ? (uint8_t)exit_win : (uint8_t)(VALUE_LOSS_BASE + exit_loss);
+    }
+    place(board, &pos, false);
+
+    atomic_store_explicit(&b->values[index], value, memory_order_relaxed);
+    atomic_store_explicit(&b->counters[index], (uint8_t)counter, memory_order_relaxed);
+    b->exit_wins[index] = (uint8_t)exit_win;
+    b->exit_losses[index] = (uint8_t)exit_loss;
+}
+
+
+static void* init_worker(void* arg)
+{
+    worker_t* w = arg;
+    board_t* board = create_board(TB_BOARD_SIZE, TB_BOARD_SIZE);
+    for (uint64_t i = w->begin; i < w->end; i++)
+        init_position(w->builder, board, i);
+    destroy_board(board);
+    return NULL;
+}
+
+
+static bool on_board(int row, int col)
+{
+    return row >= 0 && row < TB_BOARD_SIZE && col >= 0 && col < TB_BOARD_SIZE;
+}
+
+
+static void add_parent(const tb_position_t* pos, int piece, int from, uint64_t* parents, int* count)
+{
+    tb_position_t parent = *pos;
+    parent.squares[piece] = from;
+    parent.turn = opponent(pos->turn);
+    add_relative(parents, count, index_of(&parent));
+}
+
+
+static void add_step_parents(const tb_position_t* pos, const bool* occupied, int piece,
+    const delta_t* deltas, int delta_count, bool slides, uint64_t* parents, int* count)
+{
+    int row = pos->squares[piece] / TB_BOARD_SIZE;
+    int col = pos->squares[piece] % TB_BOARD_SIZE;
+    for (int d = 0; d < delta_count; d++)
+    {
+        int r = row + deltas[d].row;
+        int c = col + deltas[d].col;
+        while (on_board(r, c) && !occupied[r * TB_BOARD_SIZE + c])
+        {
+            add_parent(pos, piece, r * TB_BOARD_SIZE + c, parents, count);
+            if (!slides)
+                break;
+            r += deltas[d].row;
+            c += deltas[d].col;
+        }
+    }
+}
+
+
+static int find_parents(const tb_position_t* pos, uint64_t* parents)
+{
+    /* positions one quiet move before this one: the side not to move takes
+     * a piece back to any empty square it could have come from */
+    bool occupied[TB_SQUARES] = { false };
+    for (int i = 0; i < pos->count; i++)
+        occupied[pos->squares[i]] = true;
+    colour_t mover = opponent(pos->turn);
+    int count = 0;
+    for (int i = 0; i < pos->count; i++)
+    {
+        if (pos->pieces[i].colour != mover)
+            continue;
+        switch (pos->pieces[i].type)
+        {
+            case PIECE_TYPE_KING:
+                add_step_parents(pos, occupied, i, king_deltas, 8, false, parents, &count);
+                break;
+            case PIECE_TYPE_KNIGHT:
+                add_step_parents(pos, occupied, i, knight_deltas, 8, false, parents, &count);
+                break;
+            case PIECE_TYPE_BISHOP:
+                add_step_parents(pos, occupied, i, bishop_deltas, 4, true, parents, &count);
+                break;
+            case PIECE_TYPE_ROOK:
+                add_step_parents(pos, occupied, i, rook_deltas, 4, true, parents, &count);
+                break;
+            case PIECE_TYPE_QUEEN:
+                add_step_parents(pos, occupied, i, bishop_deltas, 4, true, parents, &count);
+                add_step_parents(pos, occupied, i, rook_deltas, 4, true, parents, &count);
+                break;
+            case PIECE_TYPE_PAWN:
+            {
+                /* white pawns move towards row 0 */
+                int back = (mover == COLOUR_WHITE) ? TB_BOARD_SIZE : -TB_BOARD_SIZE;
+                int sq = pos->squares[i];
+                int from = sq + back;
+                int row = from / TB_BOARD_SIZE;
+                if (row < 1 || row > TB_BOARD_SIZE - 2 || occupied[from])
+                    break;
+                add_parent(pos, i, from, parents, &count);
+                int double_row = (mover == COLOUR_WHITE) ? TB_BOARD_SIZE - 4 : 3;
+                if (sq / TB_BOARD_SIZE == double_row && !occupied[from + back])
+                    add_parent(pos, i, from + back, parents, &count);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return count;
+}
+
+
+static void note_depth(builder_t* b, int ply)
+{
+    int deepest = atomic_load(&b->deepest);
+    while (ply > deepest && !atomic_compare_exchange_weak(&b->deepest, &deepest, ply))
+        ;
+}
+
+
+static void resolve_parents(builder_t* b, uint64_t index, bool child_lost)
+{
+    /* a lost child makes its parents wins one ply later; a won child is
+     * one fewer way out, and a parent with none left is lost */
+    tb_position_t pos;
+    tb_decode(b->signature, index, &pos);
+    uint64_t parents[MAX_RELATIVES];
+    int count = find_parents(&pos, parents);
+    int ply = b->ply;
+    for (int i = 0; i < count; i++)
+    {
+        uint64_t p = parents[i];
+        uint8_t expected = VALUE_UNKNOWN;
+        if (child_lost)
+        {
+            if (atomic_compare_exchange_strong(&b->values[p], &expected, (uint8_t)(ply + 1)))
+                note_depth(b, ply + 1);
+            continue;
+        }
+        if (atomic_load_explicit(&b->values[p], memory_order_relaxed) != VALUE_UNKNOWN)
+            continue;
+        if (atomic_fetch_sub(&b->counters[p], 1) != 1 || b->exit_wins[p])
+            continue;
+        int loss = ply + 1 > b->exit_losses[p] ? ply + 1 : b->exit_losses[p];
+        if (atomic_compare_exchange_strong(&b->values[p], &expected, (uint8_t)(VALUE_LOSS_BASE + loss)))
+            note_depth(b, loss);
+    }
+}
+
+
+static void* level_worker(void* arg)
+{
+    worker_t* w = arg;
+    builder_t* b = w->builder;
+    uint8_t win = (uint8_t)b->ply;
+    uint8_t loss = (uint8_t)(VALUE_LOSS_BASE + b->ply);
+    for (uint64_t i = w->begin; i < w->end; i++)
+    {
+        uint8_t value = atomic_load_explicit(&b->values[i], memory_order_relaxed);
+        if (value == VALUE_UNKNOWN && b->exit_wins[i] && b->exit_wins[i] == b->ply)
+        {
+            /* a capture or promotion that wins at this ply, nothing
+             * quicker was found in the table */
+            uint8_t expected = VALUE_UNKNOWN;
+            if (atomic_compare_exchange_strong(&b->values[i], &expected, win))
+                value = win;
+            else
+                value = expected;
+        }
+        if (b->ply && value == win)
+            resolve_parents(b, i, false);
+        else if (value == loss)
+            resolve_parents(b, i, true);
+    }
+    return NULL;
+}
+
+
+static void* exit_depth_worker(void* arg)
+{
+    worker_t* w = arg;
+    builder_t* b = w->builder;
+    for (uint64_t i = w->begin; i < w->end; i++)
+    {
+        uint8_t value = atomic_load_explicit(&b->values[i], memory_order_relaxed);
+        if (value == VALUE_ILLEGAL || value == VALUE_DRAWN)
+            continue;
+        note_depth(b, b->exit_wins[i]);
+        if (IS_WIN(value))
+            note_depth(b, value);
+        else if (IS_LOSS(value))
+            note_depth(b, value - VALUE_LOSS_BASE);
+    }
+    return NULL;
+}
+
+
+static uint8_t to_cell(uint8_t value)
+{
+    if (value == VALUE_ILLEGAL)
+        return TB_ILLEGAL;
+    if (IS_WIN(value))
+        return (uint8_t)(TB_WIN | ((value + 1) / 2) << TB_CELL_DTM_SHIFT);
+    if (IS_LOSS(value))
+        return (uint8_t)(TB_LOSS | ((value - VALUE_LOSS_BASE) / 2) << TB_CELL_DTM_SHIFT);
+    return TB_DRAW;
+}
+
+
+static void write_table(builder_t* b, const char* path)
+{
+    /* the working values are streamed out as cells a chunk at a time, so
+     * only the values are held while writing */
+    unsigned long long counts[TB_ILLEGAL + 1] = { 0 };
+    int longest = 0;
+    uint8_t cells[WRITE_CHUNK];
+
+    char tmp[TB_PATH_LEN];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    if (!f)
+        raise_error(errno, "could not create '%s'", tmp); /* exits here */
+    unsigned char header[TB_HEADER_SIZE] = { 0 };
+    memcpy(header, TB_MAGIC, strlen(TB_MAGIC));
+    memcpy(header + strlen(TB_MAGIC), b->signature, strlen(b->signature));
+    if (fwrite(header, sizeof(header), 1, f) != 1)
+        raise_error(errno, "could not write '%s'", tmp); /* exits here */
+    for (uint64_t begin = 0; begin < b->positions; begin += WRITE_CHUNK)
+    {
+        size_t len = (b->positions - begin < WRITE_CHUNK) ? (size_t)(b->positions - begin) : WRITE_CHUNK;
+        for (size_t i = 0; i < len; i++)
+        {
+            cells[i] = to_cell(atomic_load_explicit(&b->values[begin + i], memory_order_relaxed));
+            counts[cells[i] & TB_CELL_WDL_MASK]++;
+            if ((cells[i] & TB_CELL_WDL_MASK) == TB_WIN && cells[i] >> TB_CELL_DTM_SHIFT > longest)
+                longest = cells[i] >> TB_CELL_DTM_SHIFT;
+        }
+        if (fwrite(cells, 1, len, f) != len)
+            raise_error(errno, "could not write '%s'", tmp); /* exits here */
+    }
+    if (fclose(f))
+        raise_error(errno, "could not write '%s'", tmp); /* exits here */
+    if (rename(tmp, path))
+        raise_error(errno, "could not rename '%s'", tmp); /* exits here */
+
+    printf("%s: %llu wins, %llu draws, %llu losses, %llu illegal, longest mate %d\n",
+        b->signature, counts[TB_WIN], counts[TB_DRAW], counts[TB_LOSS], counts[TB_ILLEGAL], longest);
+}
+
+
+static void build(const char* dir, const char* signature);
+
+
+static void build_dependencies(const char* dir, const char* signature)
+{
+    /* every table a capture or promotion can lead to */
+    size_t len = strlen(signature);
+    for (size_t i = 0; i < len; i++)
+    {
+        if (signature[i] == 'K')
+            continue;
+        char sub[TB_SIGNATURE_LEN];
+        char normalised[TB_SIGNATURE_LEN];
+        memcpy(sub, signature, i);
+        strcpy(sub + i, signature + i + 1);
+        if (tb_normalise_signature(sub, normalised) && strlen(normalised) > 2)
+            build(dir, normalised);
+        if (signature[i] != 'P')
+            continue;
+        const char promotions[] = "QRBN";
+        for (const char* p = promotions; *p; p++)
+        {
+            strcpy(sub, signature);
+            sub[i] = *p;
+            if (tb_normalise_signature(sub, normalised))
+                build(dir, normalised);
+        }
+    }
+}
+
+
+static bool mark_built(const char* signature)
+{
+    /* false if the table was already built or loaded by this run */
+    for (int i = 0; i < built_count; i++)
+    {
+        if (!strcmp(built[i], signature))
+            return false;
+    }
+    if (built_count >= TB_MAX_TABLES)
+        raise_error(E2BIG, "more than %d tables", TB_MAX_TABLES); /* exits here */
+    strcpy(built[built_count++], signature);
+    return true;
+}
+
+
+static void build(const char* dir, const char* signature)
+{
+    if (!mark_built(signature))
+        return;
+    build_dependencies(dir, signature);
+    char path[TB_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s.tb", dir, signature);
+    struct stat st;
+    if (stat(path, &st) == 0)
+    {
+        /* left by an earlier run */
+        if (!tb_load(path))
+            raise_error(EINVAL, "could not load '%s', remove it to rebuild", path); /* exits here */
+        return;
+    }
+
+    builder_t b;
+    memset(&b, 0, sizeof(b));
+    strcpy(b.signature, signature);
+    b.positions = tb_table_positions(signature);
+    b.values = calloc(b.positions, 1);
+    b.counters = calloc(b.positions, 1);
+    b.exit_wins = calloc(b.positions, 1);
+    b.exit_losses = calloc(b.positions, 1);
+    if (!b.values || !b.counters || !b.exit_wins || !b.exit_losses)
+        raise_error(ENOMEM, "no memory for %s", signature); /* exits here */
+
+    uint64_t start = monotonic_us();
+    run_workers(&b, init_worker);
+    run_workers(&b, exit_depth_worker);
+    for (b.ply = 0; b.ply <= MAX_PLIES && b.ply <= atomic_load(&b.deepest); b.ply++)
+        run_workers(&b, level_worker);
+    if (atomic_load(&b.deepest) > MAX_PLIES)
+        raise_error(ERANGE, "%s has mates too long to store", signature); /* exits here */
+
+    /* only the values are needed from here on */
+    free(b.counters);
+    free(b.exit_losses);
+    free(b.exit_wins);
+    write_table(&b, path);
+    free(b.values);
+    printf("%s: %llu positions in %.2fs\n", signature, (unsigned long long)b.positions,
+        (double)(monotonic_us() - start) / 1000000.0);
+    tb_load(path);
+}
+
+
+int main(int argc, char** argv)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    worker_count = cores > 0 ? (int)cores : 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:")) != -1)
+    {
+        if (opt != 'j')
+            usage(argv[0]);
+        worker_count = atoi(optarg);
+    }
+    if (argc - optind < 2 || worker_count < 1)
+        usage(argv[0]);
+    if (worker_count > MAX_WORKERS)
+        worker_count = MAX_WORKERS;
+
+    const char* dir = argv[optind];
+    mkdir(dir, 0755);
+    for (int i = optind + 1; i < argc; i++)
+    {
+        char signature[TB_SIGNATURE_LEN];
+        if (strlen(argv[i]) >= TB_SIGNATURE_LEN || !tb_normalise_signature(argv[i], signature) || strlen(signature) < 3)
+            raise_error(EINVAL, "'%s' is not a table of 3 to %d pieces", argv[i], TB_MAX_PIECES); /* exits here */
+        build(dir, signature);
+    }
+    return EXIT_SUCCESS;
+}
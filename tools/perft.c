@@ -0,0 +1,175 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "fen.h"
+#include "move.h"
+#include "perft.h"
+#include "rules.h"
+#include "util.h"
+
+
+#define START_FEN               "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w"
+#define SUITE_LINE_LEN          1024
+
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [--divide] <depth> [fen]\n"
+        "       %s --suite <file> [max depth]\n",
+        prog, prog);
+    exit(EXIT_FAILURE);
+}
+
+
+static void report(int depth, uint64_t nodes, uint64_t elapsed_us)
+{
+    double nps = elapsed_us ? (double)nodes * 1000000.0 / (double)elapsed_us : 0.0;
+    printf("depth %2d  nodes %12llu  time %8.3fs  nps %12.0f\n",
+        depth, (unsigned long long)nodes, (double)elapsed_us / 1000000.0, nps);
+}
+
+
+static uint64_t divide(board_t* board, colour_t turn, int depth)
+{
+    /* per root move counts, to bisect a mismatch against another engine */
+    move_list_t list;
+    generate_all_moves(board, turn, &list);
+    colour_t next = (turn == COLOUR_WHITE) ? COLOUR_BLACK : COLOUR_WHITE;
+    uint64_t total = 0;
+    for (int i = 0; i < list.count; i++)
+    {
+        char uci[8];
+        move_to_uci(board, &list.moves[i], uci, sizeof(uci));
+        undo_t undo;
+        make_move(board, &list.moves[i], &undo);
+        uint64_t nodes = perft(board, next, depth - 1);
+        unmake_move(board, &undo);
+        printf("%s: %llu\n", uci, (unsigned long long)nodes);
+        total += nodes;
+    }
+    printf("\nmoves %d\n", list.count);
+    return total;
+}
+
+
+static void run_position(const char* fen, int depth, bool split)
+{
+    colour_t turn = COLOUR_WHITE;
+    board_t* board = parse_fen(fen, &turn);
+    if (!board)
+        raise_error(EINVAL, "invalid fen '%s'", fen); /* exits here */
+    uint64_t start = monotonic_us();
+    uint64_t nodes = split ? divide(board, turn, depth) : perft(board, turn, depth);
+    report(depth, nodes, monotonic_us() - start);
+    destroy_board(board);
+}
+
+
+static bool run_suite_line(char* line, int max_depth, uint64_t* total_nodes, uint64_t* total_us)
+{
+    /* <fen> ;D1 <nodes> ;D2 <nodes> ... */
+    char* field = strchr(line, ';');
+    if (!field)
+        return true;
+    *field++ = '\0';
+    printf("%s\n", line);
+
+    colour_t turn = COLOUR_WHITE;
+    board_t* board = parse_fen(line, &turn);
+    if (!board)
+    {
+        printf("  invalid fen\n");
+        return false;
+    }
+    bool ok = true;
+    while (field)
+    {
+        char* next = strchr(field, ';');
+        if (next)
+            *next++ = '\0';
+        int depth = 0;
+        unsigned long long expected = 0;
+        if (sscanf(field, " D%d %llu", &depth, &expected) != 2)
+        {
+            printf("  malformed entry '%s'\n", field);
+            ok = false;
+        }
+        else if (depth <= max_depth)
+        {
+            uint64_t start = monotonic_us();
+            uint64_t nodes = perft(board, turn, depth);
+            uint64_t elapsed = monotonic_us() - start;
+            *total_nodes += nodes;
+            *total_us += elapsed;
+            printf("  ");
+            report(depth, nodes, elapsed);
+            if (nodes != expected)
+            {
+                printf("  FAIL: expected %llu\n", expected);
+                ok = false;
+            }
+        }
+        field = next;
+    }
+    destroy_board(board);
+    return ok;
+}
+
+
+static bool run_suite(const char* path, int max_depth)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        raise_error(errno, "could not open suite '%s'", path);
+
+    char line[SUITE_LINE_LEN];
+    int failures = 0;
+    uint64_t total_nodes = 0;
+    uint64_t total_us = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+        if (!run_suite_line(line, max_depth, &total_nodes, &total_us))
+            failures++;
+    }
+    fclose(f);
+
+    double nps = total_us ? (double)total_nodes * 1000000.0 / (double)total_us : 0.0;
+    printf("\ntotal nodes %llu, %.0f nps, %d failing position%s\n",
+        (unsigned long long)total_nodes, nps, failures, failures == 1 ? "" : "s");
+    return failures == 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc >= 3 && !strcmp(argv[1], "--suite"))
+    {
+        int max_depth = (argc >= 4) ? atoi(argv[3]) : INT_MAX;
+        return run_suite(argv[2], max_depth) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    int arg = 1;
+    bool split = false;
+    if (arg < argc && !strcmp(argv[arg], "--divide"))
+    {
+        split = true;
+        arg++;
+    }
+    if (arg >= argc)
+        usage(argv[0]);
+    int depth = atoi(argv[arg++]);
+    if (depth < 1)
+        usage(argv[0]);
+    const char* fen = (arg < argc) ? argv[arg] : START_FEN;
+    run_position(fen, depth, split);
+    return EXIT_SUCCESS;
+}
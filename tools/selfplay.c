@@ -0,0 +1,282 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "board.h"
+#include "fen.h"
+#include "game.h"
+#include "move.h"
+#include "movegen.h"
+#include "movegen/search.h"
+#include "tt.h"
+#include "util.h"
+
+
+#define START_FEN               "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w"
+#define OPENING_LINE_LEN        1024
+#define MAX_OPENINGS            1024
+#define MAX_WORKERS             256
+#define DEFAULT_GAMES           100
+#define DEFAULT_MAX_PLIES       300
+#define DEFAULT_MOVE_TIME_MS    50
+
+
+typedef struct
+{
+    board_t* board;
+    colour_t turn;
+} opening_t;
+
+typedef struct
+{
+    const movegen_t* engines[2];    /* engine under test first */
+    opening_t openings[MAX_OPENINGS];
+    int opening_count;
+    int games;
+    int max_plies;
+    search_limits_t search;
+    uint64_t seed;              /* each game's random choices follow from it */
+    atomic_int next_game;
+} tournament_t;
+
+typedef struct
+{
+    int wins;
+    int draws;
+    int losses;
+    long moves;
+    uint64_t move_us;
+} results_t;
+
+typedef struct
+{
+    tournament_t* tournament;
+    results_t results;
+    pthread_t thread;
+} worker_t;
+
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [-g games] [-j threads] [-p max plies] [-t ms per move]\n"
+        "       %*s [-d search depth] [-o openings file] [-s seed] <movegen> <opponent>\n",
+        prog, (int)strlen(prog), "");
+    exit(EXIT_FAILURE);
+}
+
+
+static void add_opening(tournament_t* t, const char* fen)
+{
+    if (t->opening_count >= MAX_OPENINGS)
+        raise_error(E2BIG, "more than %d openings", MAX_OPENINGS); /* exits here */
+    opening_t* o = &t->openings[t->opening_count++];
+    o->turn = COLOUR_WHITE;
+    o->board = parse_fen(fen, &o->turn);
+    if (!o->board)
+        raise_error(EINVAL, "invalid opening '%s'", fen); /* exits here */
+}
+
+
+static void load_openings(tournament_t* t, const char* path)
+{
+    /* one fen per line, anything after a ';' is ignored so epd suites work */
+    FILE* f = fopen(path, "r");
+    if (!f)
+        raise_error(errno, "could not open openings '%s'", path); /* exits here */
+    char line[OPENING_LINE_LEN];
+    while (fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, ";\r\n")] = '\0';
+        if (line[0] == '#' || line[0] == '\0')
+            continue;
+        add_opening(t, line);
+    }
+    fclose(f);
+    if (!t->opening_count)
+        raise_error(EINVAL, "no openings in '%s'", path); /* exits here */
+}
+
+
+static int play_game(tournament_t* t, int index, results_t* results)
+{
+    /* each opening is played twice in a row with colours swapped; returns
+     * the score of the engine under test: 1 win, 0 draw, -1 loss */
+    const opening_t* opening = &t->openings[(index / 2) % t->opening_count];
+    game_config_t cfg = {opening->board->width, opening->board->height, true, true, true};
+    /* its own random state, so games neither share one across threads nor
+     * repeat each other, and a seed replays the whole tournament */
+    uint64_t seed = t->seed + (uint64_t)index;
+    cfg.random_state = random_next(&seed);
+    cfg.search = t->search;
+    game_t* game = game_create(&cfg);
+    game_set_board(game, opening->board, opening->turn);
+
+    bool tested_white = (index % 2) == 0;
+    colour_t tested = tested_white ? COLOUR_WHITE : COLOUR_BLACK;
+    int score = 0;
+    for (int ply = 0; ply < t->max_plies; ply++)
+    {
+        game_status_t status = game_get_status(game);
+        colour_t turn = game_current_turn(game);
+        if (status == STATUS_CHECKMATE)
+        {
+            score = (turn == tested) ? -1 : 1;
+            break;
+        }
+        if (status != STATUS_ONGOING && status != STATUS_CHECK)
+            break;
+
+        const movegen_t* engine = t->engines[turn == tested ? 0 : 1];
+        move_t m = move_encode(0, 0, PIECE_TYPE_EMPTY, MOVE_FLAG_NONE);
+        game_history_t history;
+        game_get_history(game, &history);
+        uint64_t start = monotonic_us();
+        bool found = engine->generator(&game->config, game->board, turn,
+            game_get_legal_moves(game), game_get_scratch(game), &m, status, &history);
+        results->move_us += monotonic_us() - start;
+        results->moves++;
+        if (!found || !game_apply_move(game, &m))
+        {
+            /* an engine that can't produce a legal move forfeits */
+            printf("game %d: %s failed to move\n", index, engine->name);
+            score = (turn == tested) ? -1 : 1;
+            break;
+        }
+    }
+    game_destroy(game);
+    return score;
+}
+
+
+static void* worker_main(void* arg)
+{
+    worker_t* w = arg;
+    tournament_t* t = w->tournament;
+    for (;;)
+    {
+        int index = atomic_fetch_add(&t->next_game, 1);
+        if (index >= t->games)
+            break;
+        int score = play_game(t, index, &w->results);
+        if (score > 0)
+            w->results.wins++;
+        else if (score < 0)
+            w->results.losses++;
+        else
+            w->results.draws++;
+    }
+    return NULL;
+}
+
+
+static void report(const tournament_t* t, const results_t* r, uint64_t elapsed_us, uint64_t nodes)
+{
+    int played = r->wins + r->draws + r->losses;
+    double score = played ? (r->wins + 0.5 * r->draws) / played : 0.0;
+    printf("%s vs %s: %d games, seed %llu\n", t->engines[0]->name, t->engines[1]->name, played,
+        (unsigned long long)t->seed);
+    printf("  +%d =%d -%d  score %.1f%%", r->wins, r->draws, r->losses, score * 100.0);
+    if (score > 0.0 && score < 1.0)
+        printf("  elo %+.0f", -400.0 * log10(1.0 / score - 1.0));
+    printf("\n");
+
+    double seconds = (double)elapsed_us / 1000000.0;
+    double move_seconds = (double)r->move_us / 1000000.0;
+    printf("  %.3fs, %.2f games/s\n", seconds, seconds > 0.0 ? played / seconds : 0.0);
+    printf("  %ld moves, %.3f ms/move\n", r->moves, r->moves ? move_seconds * 1000.0 / r->moves : 0.0);
+    /* only the search generator counts nodes, per thread of move time */
+    printf("  %llu nodes, %.0f nps\n", (unsigned long long)nodes,
+        move_seconds > 0.0 ? (double)nodes / move_seconds : 0.0);
+}
+
+
+int main(int argc, char** argv)
+{
+    static tournament_t t;
+    t.games = DEFAULT_GAMES;
+    t.max_plies = DEFAULT_MAX_PLIES;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int worker_count = cores > 0 ? (int)cores : 1;
+    int move_time_ms = DEFAULT_MOVE_TIME_MS;
+    int search_depth = 0;
+    const char* openings_path = NULL;
+    t.seed = random_seed();
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:j:p:t:d:o:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'g': t.games = atoi(optarg); break;
+            case 'j': worker_count = atoi(optarg); break;
+            case 'p': t.max_plies = atoi(optarg); break;
+            case 't': move_time_ms = atoi(optarg); break;
+            case 'd': search_depth = atoi(optarg); break;
+            case 'o': openings_path = optarg; break;
+            case 's': t.seed = strtoull(optarg, NULL, 0); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2 || t.games < 1 || worker_count < 1 || t.max_plies < 1)
+        usage(argv[0]);
+    for (int i = 0; i < 2; i++)
+    {
+        t.engines[i] = movegen_find(argv[optind + i]);
+        if (!t.engines[i])
+            raise_error(EINVAL, "no movegen called '%s'", argv[optind + i]); /* exits here */
+    }
+    if (worker_count > MAX_WORKERS)
+        worker_count = MAX_WORKERS;
+    if (worker_count > t.games)
+        worker_count = t.games;
+
+    if (openings_path)
+        load_openings(&t, openings_path);
+    else
+        add_opening(&t, START_FEN);
+    movegen_search_default_limits(&t.search);
+    movegen_search_set_limits(&t.search, search_depth, move_time_ms, 0);
+
+    /* the transposition table is made lazily, so it is set up here before
+     * any worker searches */
+    tt_init();
+
+    static worker_t workers[MAX_WORKERS];
+    uint64_t start = monotonic_us();
+    uint64_t start_nodes = movegen_search_total_nodes();
+    int started = 0;
+    for (; started < worker_count; started++)
+    {
+        workers[started].tournament = &t;
+        if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]))
+            break;
+    }
+    if (!started)
+        raise_error(EAGAIN, "could not start any workers"); /* exits here */
+
+    results_t total = {0};
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        total.wins += workers[i].results.wins;
+        total.draws += workers[i].results.draws;
+        total.losses += workers[i].results.losses;
+        total.moves += workers[i].results.moves;
+        total.move_us += workers[i].results.move_us;
+    }
+    report(&t, &total, monotonic_us() - start, movegen_search_total_nodes() - start_nodes);
+
+    for (int i = 0; i < t.opening_count; i++)
+        destroy_board(t.openings[i].board);
+    return EXIT_SUCCESS;
+}